@@ -0,0 +1,441 @@
+/*! \file
+
+\page bench_des4 The Simplified DES Attack Benchmark
+
+\section background_bench_des4 Background
+
+The 4-round differential attack on the simplified DES (des4::crack4) encrypts a number of chosen plaintexts
+and is likely to fail when that number is small. This benchmark measures how likely it is to succeed for each
+of a list of trial counts, so the cheapest count which meets a target success rate can be chosen.
+
+For each trial count, the attack is run against simulated oracles (see des4_oracle.h), each holding a key
+drawn from a seeded generator. The same keys are used for every trial count, so the counts are compared on
+the same cases. An attack succeeds when it returns exactly the hidden key; attacks which give up count as failures.
+For each trial count, the benchmark reports
+    - The success rate, with a 95% Wilson score interval
+    - The number of attacks which gave up rather than returning a wrong key
+    - The median number of blocks the oracle was asked to encrypt per attack
+    - The median and mean wall time per attack
+
+The attacks are split between a pool of threads. The results are written as JSON or CSV (see bench_report.h).
+
+\section compile_bench_des4 Compiling
+This benchmark can be built with the command
+\verbatim
+make
+\endverbatim
+This will generate a release version of the benchmark in the release directory. To build a debug version in the debug directory,
+use the command
+\verbatim
+make BUILD_TYPE=debug
+\endverbatim
+
+\section usage_bench_des4 Usage
+\verbatim
+bench_des4 [options]
+\endverbatim
+Options
+    - -f format : The output format; one of json, csv. Defaults to json
+    - -of file : Write the results to the file 'file' instead of the terminal
+    - -t trials : Comma separated trial counts to pass to crack4. Defaults to 2,4,6,8,10,12,16,20,24,32
+    - -n attacks : Number of attacks for each trial count. Defaults to 1000
+    - -target rate : Success rate to look for, between 0 and 1. Defaults to 0.99
+    - -seed s : Seed for the hidden keys. Defaults to 1
+    - -j n : Number of threads; 0 uses one thread per core. Defaults to 0
+
+The cheapest trial count whose success rate is at least the target is reported, or -1 if none is.
+*/
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "des4.h"
+#include "des4_oracle.h"
+#include "parallel.h"
+#include "bench_report.h"
+
+using namespace std;
+using namespace des4_engine;
+
+//! Number of attacks given to a thread at a time
+const size_t ATTACK_CASES = 32;
+
+//! Measured results for one trial count
+struct result
+{
+    //! Number of plaintexts given to crack4
+    uint64_t trials;
+
+    //! Number of attacks
+    uint64_t attacks;
+
+    //! Number of attacks which found the hidden key
+    uint64_t successes;
+
+    //! Number of attacks which gave up
+    uint64_t gaveUp;
+
+    //! Blocks the oracle encrypted, for each attack
+    vector<uint64_t> queries;
+
+    //! Wall time, for each attack
+    vector<double> seconds;
+};
+
+//! A piece of the attacks for one trial count
+struct attack_chunk
+{
+    //! Hidden keys to attack
+    vector<uint16_t> keys;
+
+    //! Number of attacks which found the hidden key
+    uint64_t successes;
+
+    //! Number of attacks which gave up
+    uint64_t gaveUp;
+
+    //! Blocks the oracle encrypted, for each attack
+    vector<uint64_t> queries;
+
+    //! Wall time, for each attack
+    vector<double> seconds;
+};
+
+/*! Processes the command line arguments
+
+If the arguments are invalid, a usage prompt is printed with an error message
+
+\param[in] argc Number of arguments
+\param[in] argv The arguments
+\param[out] format Output format
+\param[out] output File name to output to; empty for the terminal
+\param[out] trials Trial counts to measure
+\param[out] attacks Number of attacks for each trial count
+\param[out] target Success rate to look for
+\param[out] seed Seed for the hidden keys
+\param[out] threads Number of threads
+\returns bool - Whether or not the arguments were valid
+*/
+bool processArgs(int argc, char** argv, string& format, string& output, vector<uint64_t>& trials, uint64_t& attacks, double& target, uint32_t& seed, unsigned& threads);
+
+/*! Prints the program usage prompt with an error message
+
+\param[in] name Name of the program
+\param[in] msg Error message to print
+*/
+void help(string name, string msg = "");
+
+/*! Runs crack4 against simulated oracles with keys from a seeded generator
+
+\param[in] trials Number of plaintexts to give crack4
+\param[in] attacks Number of attacks
+\param[in] seed Seed for the hidden keys
+\param[in] threads Number of threads
+\returns result - The outcome of every attack
+*/
+result measure(uint64_t trials, uint64_t attacks, uint32_t seed, unsigned threads);
+
+/*! Finds the median of some values
+
+\param[in] values The values; reordered
+\returns double - The median, or the mean of the two middle values for an even count
+*/
+template<class T>
+double median(vector<T>& values);
+
+/*! Computes a 95% Wilson score interval for a success rate
+
+\param[in] successes Number of successes
+\param[in] count Number of attempts
+\param[out] low Lower end of the interval
+\param[out] high Upper end of the interval
+*/
+void wilson(uint64_t successes, uint64_t count, double& low, double& high);
+
+/*! Summarizes the results for one trial count for the report
+
+\param[in] r The results; the queries and times are reordered
+\returns bench::record - The trial count, success rate and interval, attacks which gave up, and the medians and mean
+*/
+bench::record summarize(result& r);
+
+/*!
+    Processes the command line arguments. If they are invalid, the application terminates.
+
+    For each trial count, the generator is seeded again so every count attacks the same keys.
+    Keys are drawn on the calling thread and the attacks are handed to the threads ATTACK_CASES
+    at a time, so the results do not depend on the number of threads apart from the times.
+
+    All results are written once everything has been measured.
+
+    \param[in] argc Number of command line arguments
+    \param[in] argv The command line arguments
+    \returns 0 - The program ran successfully
+    \returns 1 - The command line arguments were invalid
+    \returns 2 - A file could not be opened
+*/
+int main(int argc, char** argv)
+{
+    string format, output;
+    vector<uint64_t> trials;
+    uint64_t attacks;
+    double target;
+    uint32_t seed;
+    unsigned threads;
+
+    if(!processArgs(argc, argv, format, output, trials, attacks, target, seed, threads))
+    {
+        return 1;
+    }
+
+    ofstream outFile;
+    ostream* outStream = &cout;
+    if(!output.empty())
+    {
+        outFile.open(output, ios::trunc);
+        if(!outFile)
+        {
+            help(argv[0], "Unable to open output file " + output);
+            return 2;
+        }
+
+        outStream = &outFile;
+    }
+
+    vector<result> results;
+    long long cheapest = -1;
+    for(uint64_t t : trials)
+    {
+        results.push_back(measure(t, attacks, seed, threads));
+
+        const result& r = results.back();
+        if((double)r.successes / r.attacks >= target && (cheapest < 0 || (long long)t < cheapest))
+            cheapest = t;
+    }
+
+    vector<bench::record> records;
+    for(result& r : results)
+        records.push_back(summarize(r));
+
+    if(format == "csv")
+    {
+        bench::writeCsv(*outStream, records);
+    }
+    else
+    {
+        stringstream fields;
+        fields << "\"target\": " << target << ", \"cheapest_trials\": " << cheapest;
+        bench::writeJson(*outStream, records, fields.str());
+    }
+
+    outFile.close();
+
+    return 0;
+}
+
+bool processArgs(int argc, char** argv, string& format, string& output, vector<uint64_t>& trials, uint64_t& attacks, double& target, uint32_t& seed, unsigned& threads)
+{
+    format = "json";
+    output = "";
+    bench::parseSizes("2,4,6,8,10,12,16,20,24,32", trials);
+    attacks = 1000;
+    target = 0.99;
+    seed = 1;
+    threads = parallel::hardwareThreads();
+
+    for(int i=1; i<argc; i++)
+    {
+        string arg = argv[i];
+
+        if(i >= argc-1)
+        {
+            help(argv[0], "Option " + arg + " needs a value");
+            return false;
+        }
+
+        string value = argv[++i];
+        if(arg == "-f")
+        {
+            if(value != "json" && value != "csv")
+            {
+                help(argv[0], "Output format must be one of json, csv");
+                return false;
+            }
+            format = value;
+        }
+        else if(arg == "-of")
+        {
+            output = value;
+        }
+        else if(arg == "-t")
+        {
+            if(!bench::parseSizes(value, trials))
+            {
+                help(argv[0], "Trial counts must be positive numbers separated by commas");
+                return false;
+            }
+        }
+        else if(arg == "-n" || arg == "-seed" || arg == "-j")
+        {
+            unsigned long long n;
+            try
+            {
+                if(value.find_first_not_of("0123456789") != string::npos) throw logic_error("");
+                n = stoull(value);
+            }catch(exception& ex)
+            {
+                help(argv[0], "Specify a number with " + arg + " [number]");
+                return false;
+            }
+
+            if(arg == "-n")
+            {
+                if(n == 0)
+                {
+                    help(argv[0], "Specify a positive number with -n [attacks]");
+                    return false;
+                }
+                attacks = n;
+            }
+            else if(arg == "-seed")
+            {
+                seed = n;
+            }
+            else
+            {
+                threads = (n ? n : parallel::hardwareThreads());
+            }
+        }
+        else if(arg == "-target")
+        {
+            try
+            {
+                target = stod(value);
+            }catch(exception& ex)
+            {
+                target = -1;
+            }
+
+            if(!(target >= 0 && target <= 1))
+            {
+                help(argv[0], "Target success rate must be between 0 and 1");
+                return false;
+            }
+        }
+        else
+        {
+            help(argv[0], "Unknown option: " + arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void help(string name, string msg)
+{
+    cout << msg << endl << endl;
+
+    cout << "bench_des4 [options]\n\
+Options\n\
+    -f format : The output format; one of json, csv. Defaults to json\n\
+    -of file : Write the results to the file 'file' instead of the terminal\n\
+    -t trials : Comma separated trial counts to pass to crack4. Defaults to 2,4,6,8,10,12,16,20,24,32\n\
+    -n attacks : Number of attacks for each trial count. Defaults to 1000\n\
+    -target rate : Success rate to look for, between 0 and 1. Defaults to 0.99\n\
+    -seed s : Seed for the hidden keys. Defaults to 1\n\
+    -j n : Number of threads; 0 uses one thread per core. Defaults to 0" << endl;
+}
+
+result measure(uint64_t trials, uint64_t attacks, uint32_t seed, unsigned threads)
+{
+    result r = {trials, attacks, 0, 0, {}, {}};
+
+    mt19937 generator(seed);
+    uint64_t started = 0;
+    parallel::ordered<attack_chunk>(threads,
+        [&](attack_chunk& c)
+        {
+            c.keys.clear();
+            while(c.keys.size() < ATTACK_CASES && started < attacks)
+            {
+                c.keys.push_back(generator() % KEYS);
+                started++;
+            }
+            return !c.keys.empty();
+        },
+        [&](attack_chunk& c)
+        {
+            c.successes = 0;
+            c.gaveUp = 0;
+            c.queries.clear();
+            c.seconds.clear();
+            for(uint16_t key : c.keys)
+            {
+                simulated_oracle box(key, 4);
+
+                auto start = chrono::steady_clock::now();
+                try{
+                    if(des4::crack4(box.box(), trials) == key)
+                        c.successes++;
+                }catch(runtime_error&){
+                    c.gaveUp++;
+                }
+                c.seconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+                c.queries.push_back(box.queries());
+            }
+        },
+        [&](attack_chunk& c)
+        {
+            r.successes += c.successes;
+            r.gaveUp += c.gaveUp;
+            r.queries.insert(r.queries.end(), c.queries.begin(), c.queries.end());
+            r.seconds.insert(r.seconds.end(), c.seconds.begin(), c.seconds.end());
+        });
+
+    return r;
+}
+
+template<class T>
+double median(vector<T>& values)
+{
+    size_t half = values.size() / 2;
+    nth_element(values.begin(), values.begin() + half, values.end());
+    double middle = values[half];
+    if(values.size() % 2)
+        return middle;
+
+    return (middle + *max_element(values.begin(), values.begin() + half)) / 2;
+}
+
+void wilson(uint64_t successes, uint64_t count, double& low, double& high)
+{
+    const double z = 1.96;
+    double p = (double)successes / count;
+    double denominator = 1 + z * z / count;
+    double centre = (p + z * z / (2 * count)) / denominator;
+    double spread = z * sqrt(p * (1 - p) / count + z * z / (4.0 * count * count)) / denominator;
+
+    low = max(0.0, centre - spread);
+    high = min(1.0, centre + spread);
+}
+
+bench::record summarize(result& r)
+{
+    double low, high, total = 0;
+    wilson(r.successes, r.attacks, low, high);
+    for(double s : r.seconds)
+        total += s;
+
+    return {{"trials", r.trials}, {"attacks", r.attacks}, {"successes", r.successes},
+        {"success_rate", (double)r.successes / r.attacks}, {"rate_low", low}, {"rate_high", high},
+        {"gave_up", r.gaveUp}, {"median_queries", median(r.queries)}, {"median_seconds", median(r.seconds)},
+        {"mean_seconds", total / r.attacks}};
+}
@@ -0,0 +1,523 @@
+/*! \file
+
+\page bench_des64 The DES Benchmark
+
+\section background_bench_des64 Background
+
+This benchmark measures how fast the 64-bit DES runs, at three levels
+    - The block functions; des64::encrypt and des64::decrypt from the cryptography library, and the
+      bulk functions of each implementation in des64_engine.h, reported as nanoseconds per block
+    - The cipher modes; each mode of des64_modes.h encrypting and decrypting the whole array with the default
+      implementation, reported as nanoseconds per block. CBC and CFB encryption and OFB run one block at a time,
+      so they measure the single-block path rather than the bulk one
+    - Key setup; the time to build a key schedule for single and triple DES, reported as nanoseconds per key
+    - The tool; tool_des64 is run on synthetic files of each requested size, and the wall time of the whole
+      run (startup, file I/O, and encryption) is reported as MB/s
+
+Every measurement is repeated and the fastest repetition is kept, since slower repetitions are
+slower because of something other than the code being measured.
+
+The results are written as JSON or CSV so they can be saved and compared between builds of the
+cryptography library submodule.
+
+\section compile_bench_des64 Compiling
+This benchmark can be built with the command
+\verbatim
+make
+\endverbatim
+This will generate a release version of the benchmark in the release directory. To build a debug version in the debug directory,
+use the command
+\verbatim
+make BUILD_TYPE=debug
+\endverbatim
+The end-to-end measurements need tool_des64 to be built as well.
+
+\section usage_bench_des64 Usage
+\verbatim
+bench_des64 [options]
+\endverbatim
+Options
+    - -f format : The output format; one of json, csv. Defaults to json
+    - -of file : Write the results to the file 'file' instead of the terminal
+    - -n blocks : Number of blocks to use for the block function measurements. Defaults to 65536
+    - -r reps : Number of times to repeat each measurement. Defaults to 3
+    - -s sizes : Comma separated file sizes for the end-to-end measurements, with an optional K, M, or G suffix.
+                 Defaults to 1M,16M,64M. Use -s none to skip the end-to-end measurements
+    - -t tool : Path to tool_des64. Defaults to ../tool_des64/release/tool_des64
+    - -x impl : The implementation the tool should use; one of reference, sp, bitslice. Defaults to bitslice
+    - -j n : Number of threads the tool should use. Defaults to 1
+    - -tmp dir : Directory to write the synthetic files to. Defaults to /tmp
+
+Synthetic files are filled with pseudo-random data and removed after they have been measured, so
+the temporary directory needs enough space for two files of the largest size.
+*/
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "des64.h"
+#include "des64_engine.h"
+#include "des64_bitslice.h"
+#include "des64_modes.h"
+#include "bench_report.h"
+
+using namespace std;
+using namespace des64_engine;
+using namespace bench;
+
+//! Key used for every measurement; passes the parity check
+const uint64_t BENCH_KEY = 0x133457799BBCDFF1ULL;
+
+//! Number of keys scheduled for each key setup measurement
+const size_t KEY_SETUPS = 1 << 14;
+
+//! Number of blocks checked against the des64 library; a full bitsliced batch and a partial one
+const size_t CHECK_BLOCKS = BITSLICE_BLOCKS + 8;
+
+/*! Processes the command line arguments
+
+If the arguments are invalid, a usage prompt is printed with an error message
+
+\param[in] argc Number of arguments
+\param[in] argv The arguments
+\param[out] format Output format
+\param[out] output File name to output to; empty for the terminal
+\param[out] blocks Number of blocks for block function measurements
+\param[out] reps Number of repetitions
+\param[out] sizes File sizes for end-to-end measurements
+\param[out] tool Path to tool_des64
+\param[out] impl Implementation name to pass to the tool
+\param[out] threads Number of threads to pass to the tool
+\param[out] tmpDir Directory for synthetic files
+\returns bool - Whether or not the arguments were valid
+*/
+bool processArgs(int argc, char** argv, string& format, string& output, size_t& blocks, unsigned& reps, vector<uint64_t>& sizes, string& tool, string& impl, string& threads, string& tmpDir);
+
+/*! Prints the program usage prompt with an error message
+
+\param[in] name Name of the program
+\param[in] msg Error message to print
+*/
+void help(string name, string msg = "");
+
+/*! Fills a buffer with pseudo-random blocks
+
+\param[out] blocks The buffer
+\param[in] count Number of blocks
+\param[in,out] state xorshift state to continue from
+*/
+void fillBlocks(uint64_t* blocks, size_t count, uint64_t& state);
+
+/*! Checks that an implementation produces the same output as the des64 library
+
+\param[in] impl The implementation to check
+\param[in] schedule Key schedule to check with; single or triple DES
+\returns bool - Whether or not every block encrypted and decrypted identically
+*/
+bool checkBackend(backend impl, const key_schedule& schedule);
+
+/*! Writes a file of pseudo-random data
+
+\param[in] path File to write
+\param[in] size Number of bytes
+\returns bool - Whether the file was written
+*/
+bool writeSynthetic(const string& path, uint64_t size);
+
+/*! Runs a program and waits for it to finish. Its standard output is discarded
+
+\param[in] args Program and its arguments
+\returns bool - Whether the program ran and exited with status 0
+*/
+bool runProgram(const vector<string>& args);
+
+/*!
+    Processes the command line arguments. If they are invalid, the application terminates.
+
+    The library block functions are timed on one block at a time, and the implementations in
+    des64_engine are timed on the whole array of blocks at once; both encrypt and decrypt are measured.
+    Before it is timed, each implementation is checked against the des64 library with single and triple DES keys.
+    Each cipher mode processes the whole array as one chunk.
+    Key schedules are built for single and triple DES keys.
+
+    For each requested size, a synthetic file is written, and tool_des64 is run to encrypt it to another
+    file. The files are removed afterwards. If the tool fails to run, the end-to-end measurements are skipped.
+
+    All results are written once everything has been measured.
+
+    \param[in] argc Number of command line arguments
+    \param[in] argv The command line arguments
+    \returns 0 - The program ran successfully
+    \returns 1 - The command line arguments were invalid
+    \returns 2 - A file could not be opened
+    \returns 3 - An implementation does not match the des64 library
+*/
+int main(int argc, char** argv)
+{
+    string format, output, tool, impl, threads, tmpDir;
+    size_t blocks;
+    unsigned reps;
+    vector<uint64_t> sizes;
+
+    if(!processArgs(argc, argv, format, output, blocks, reps, sizes, tool, impl, threads, tmpDir))
+    {
+        return 1;
+    }
+
+    ofstream outFile;
+    ostream* outStream = &cout;
+    if(!output.empty())
+    {
+        outFile.open(output, ios::trunc);
+        if(!outFile)
+        {
+            help(argv[0], "Unable to open output file " + output);
+            return 2;
+        }
+
+        outStream = &outFile;
+    }
+
+    vector<result> results;
+
+    uint64_t state = 0x0123456789ABCDEFULL;
+    vector<uint64_t> plain(blocks), work(blocks);
+    fillBlocks(plain.data(), blocks, state);
+
+    //Keeps the compiler from discarding work whose result is unused
+    volatile uint64_t sink = 0;
+
+    const uint64_t key = BENCH_KEY;
+    double seconds = fastest(reps, [&]()
+    {
+        uint64_t acc = 0;
+        for(size_t i=0; i<blocks; i++)
+            acc ^= des64::encrypt(plain[i], key);
+        sink = sink ^ acc;
+    });
+    results.push_back({"block", "des64::encrypt", blocks * 8, blocks, seconds});
+
+    seconds = fastest(reps, [&]()
+    {
+        uint64_t acc = 0;
+        for(size_t i=0; i<blocks; i++)
+            acc ^= des64::decrypt(plain[i], key);
+        sink = sink ^ acc;
+    });
+    results.push_back({"block", "des64::decrypt", blocks * 8, blocks, seconds});
+
+    key_schedule schedule(BENCH_KEY);
+    key_schedule triple(BENCH_KEY, BENCH_KEY ^ 0x0303030303030303ULL, BENCH_KEY);
+    const pair<string, backend> backends[] = {{"reference", backend::Reference}, {"sp", backend::SPTable}, {"bitslice", backend::Bitslice}};
+    for(const auto& b : backends)
+    {
+        //A fast implementation is no use if it is wrong
+        if(!checkBackend(b.second, schedule) || !checkBackend(b.second, triple))
+        {
+            cerr << "The " << b.first << " implementation does not match the des64 library" << endl;
+            return 3;
+        }
+
+        block_function enc = encryptFunction(b.second), dec = decryptFunction(b.second);
+
+        seconds = fastest(reps, [&]()
+        {
+            work = plain;
+            enc(work.data(), blocks, schedule);
+        });
+        results.push_back({"block", b.first + " encrypt", blocks * 8, blocks, seconds});
+
+        seconds = fastest(reps, [&]()
+        {
+            work = plain;
+            dec(work.data(), blocks, schedule);
+        });
+        results.push_back({"block", b.first + " decrypt", blocks * 8, blocks, seconds});
+    }
+
+    vector<uint64_t> scratch(blocks);
+    const pair<string, cipher_mode> modes[] = {{"ecb", cipher_mode::ECB}, {"cbc", cipher_mode::CBC}, {"cfb", cipher_mode::CFB},
+                                               {"ofb", cipher_mode::OFB}, {"ctr", cipher_mode::CTR}};
+    for(const auto& m : modes)
+    {
+        for(bool encrypting : {true, false})
+        {
+            seconds = fastest(reps, [&]()
+            {
+                work = plain;
+                processChunk(m.second, encrypting, DEFAULT_BACKEND, schedule, work.data(), blocks, BENCH_KEY, scratch.data());
+            });
+            results.push_back({"mode", m.first + (encrypting ? " encrypt" : " decrypt"), blocks * 8, blocks, seconds});
+        }
+    }
+
+    seconds = fastest(reps, [&]()
+    {
+        work = plain;
+        processChunk(cipher_mode::CBC, true, DEFAULT_BACKEND, triple, work.data(), blocks, BENCH_KEY, scratch.data());
+    });
+    results.push_back({"mode", "cbc encrypt triple", blocks * 8, blocks, seconds});
+
+    seconds = fastest(reps, [&]()
+    {
+        for(size_t i=0; i<KEY_SETUPS; i++)
+            sink = sink ^ key_schedule(BENCH_KEY).encryptKeys()[0];
+    });
+    results.push_back({"key_setup", "single", 0, KEY_SETUPS, seconds});
+
+    seconds = fastest(reps, [&]()
+    {
+        for(size_t i=0; i<KEY_SETUPS; i++)
+            sink = sink ^ key_schedule(BENCH_KEY, BENCH_KEY ^ 0x0303030303030303ULL, BENCH_KEY).encryptKeys()[0];
+    });
+    results.push_back({"key_setup", "triple", 0, KEY_SETUPS, seconds});
+
+    string keyText;
+    {
+        stringstream k;
+        k << hex << BENCH_KEY;
+        keyText = k.str();
+    }
+
+    for(uint64_t size : sizes)
+    {
+        string inPath = tmpDir + "/bench_des64_" + to_string(getpid()) + ".in";
+        string outPath = tmpDir + "/bench_des64_" + to_string(getpid()) + ".out";
+        if(!writeSynthetic(inPath, size))
+        {
+            cerr << "Unable to write synthetic file " << inPath << endl;
+            remove(inPath.c_str());
+            return 2;
+        }
+
+        bool ran = true;
+        seconds = fastest(reps, [&]()
+        {
+            ran = ran && runProgram({tool, "-e", "-if", inPath, "-of", outPath, "-k", keyText, "-x", impl, "-j", threads});
+        });
+
+        remove(inPath.c_str());
+        remove(outPath.c_str());
+
+        if(!ran)
+        {
+            cerr << "Unable to run " << tool << "; skipping end-to-end measurements" << endl;
+            break;
+        }
+        results.push_back({"tool", impl + " -j " + threads, size, size / 8, seconds});
+    }
+
+    if(format == "csv")
+        writeCsv(*outStream, results);
+    else
+        writeJson(*outStream, results, "\"bitslice_lanes\": " + to_string(DES64_BITSLICE_LANES));
+
+    outFile.close();
+
+    return 0;
+}
+
+bool processArgs(int argc, char** argv, string& format, string& output, size_t& blocks, unsigned& reps, vector<uint64_t>& sizes, string& tool, string& impl, string& threads, string& tmpDir)
+{
+    format = "json";
+    output = "";
+    blocks = 1 << 16;
+    reps = 3;
+    tool = "../tool_des64/release/tool_des64";
+    impl = "bitslice";
+    threads = "1";
+    tmpDir = "/tmp";
+    parseSizes("1M,16M,64M", sizes);
+
+    for(int i=1; i<argc; i++)
+    {
+        string arg = argv[i];
+
+        if(i >= argc-1)
+        {
+            help(argv[0], "Option " + arg + " needs a value");
+            return false;
+        }
+
+        string value = argv[++i];
+        if(arg == "-f")
+        {
+            if(value != "json" && value != "csv")
+            {
+                help(argv[0], "Output format must be one of json, csv");
+                return false;
+            }
+            format = value;
+        }
+        else if(arg == "-of")
+        {
+            output = value;
+        }
+        else if(arg == "-n" || arg == "-r")
+        {
+            unsigned long long n;
+            try
+            {
+                n = stoull(value);
+            }catch(exception& ex)
+            {
+                n = 0;
+            }
+
+            if(n == 0)
+            {
+                help(argv[0], "Specify a positive number with " + arg + " [number]");
+                return false;
+            }
+
+            if(arg == "-n") blocks = n;
+            else reps = n;
+        }
+        else if(arg == "-s")
+        {
+            if(value == "none")
+            {
+                sizes.clear();
+            }
+            else if(!parseSizes(value, sizes))
+            {
+                help(argv[0], "Sizes must be positive numbers with an optional K, M, or G suffix, separated by commas");
+                return false;
+            }
+        }
+        else if(arg == "-t")
+        {
+            tool = value;
+        }
+        else if(arg == "-x")
+        {
+            backend b;
+            if(!backendFromName(value, b))
+            {
+                help(argv[0], "Implementation must be one of reference, sp, bitslice");
+                return false;
+            }
+            impl = value;
+        }
+        else if(arg == "-j")
+        {
+            threads = value;
+        }
+        else if(arg == "-tmp")
+        {
+            tmpDir = value;
+        }
+        else
+        {
+            help(argv[0], "Unknown option: " + arg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void help(string name, string msg)
+{
+    cout << msg << endl << endl;
+
+    cout << "bench_des64 [options]\n\
+Options\n\
+    -f format : The output format; one of json, csv. Defaults to json\n\
+    -of file : Write the results to the file 'file' instead of the terminal\n\
+    -n blocks : Number of blocks to use for the block function measurements. Defaults to 65536\n\
+    -r reps : Number of times to repeat each measurement. Defaults to 3\n\
+    -s sizes : Comma separated file sizes for the end-to-end measurements, with an optional K, M, or G suffix.\n\
+               Defaults to 1M,16M,64M. Use -s none to skip the end-to-end measurements\n\
+    -t tool : Path to tool_des64. Defaults to ../tool_des64/release/tool_des64\n\
+    -x impl : The implementation the tool should use; one of reference, sp, bitslice. Defaults to bitslice\n\
+    -j n : Number of threads the tool should use. Defaults to 1\n\
+    -tmp dir : Directory to write the synthetic files to. Defaults to /tmp" << endl;
+}
+
+void fillBlocks(uint64_t* blocks, size_t count, uint64_t& state)
+{
+    for(size_t i=0; i<count; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        blocks[i] = state;
+    }
+}
+
+bool checkBackend(backend impl, const key_schedule& schedule)
+{
+    //The same blocks every run, different for each key
+    uint64_t state = 0x0123456789ABCDEFULL ^ schedule.key();
+    vector<uint64_t> plain(CHECK_BLOCKS), cipher(CHECK_BLOCKS);
+    fillBlocks(plain.data(), CHECK_BLOCKS, state);
+    cipher = plain;
+
+    encryptFunction(impl)(cipher.data(), CHECK_BLOCKS, schedule);
+    for(size_t i=0; i<CHECK_BLOCKS; i++)
+    {
+        uint64_t expected = des64::encrypt(plain[i], schedule.key(0));
+        if(schedule.stages() == 3)
+            expected = des64::encrypt(des64::decrypt(expected, schedule.key(1)), schedule.key(2));
+
+        if(cipher[i] != expected)
+            return false;
+    }
+
+    decryptFunction(impl)(cipher.data(), CHECK_BLOCKS, schedule);
+    return cipher == plain;
+}
+
+bool writeSynthetic(const string& path, uint64_t size)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if(!out) return false;
+
+    uint64_t state = 0xFEDCBA9876543210ULL;
+    vector<uint64_t> buffer(1 << 17);
+    while(size && out)
+    {
+        fillBlocks(buffer.data(), buffer.size(), state);
+
+        uint64_t count = min<uint64_t>(size, buffer.size() * 8);
+        out.write((const char*)buffer.data(), count);
+        size -= count;
+    }
+
+    return (bool)out;
+}
+
+bool runProgram(const vector<string>& args)
+{
+    pid_t pid = fork();
+    if(pid < 0) return false;
+
+    if(pid == 0)
+    {
+        vector<char*> argv;
+        for(const string& arg : args)
+            argv.push_back((char*)arg.c_str());
+        argv.push_back(nullptr);
+
+        if(!freopen("/dev/null", "w", stdout)) _exit(127);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+    if(waitpid(pid, &status, 0) < 0) return false;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
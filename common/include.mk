@@ -0,0 +1,16 @@
+# Sources shared between the tools in this repository
+#
+# Set COMMON_LIBS to the names (without extension) of the sources in
+# $(COMMON_ROOT)/src which the tool needs before including this file.
+# COMMON_OBJECTS will be the objects to link and COMMON_HEADERS the headers
+# which the tool's objects depend on
+
+COMMON_ROOT = $(PROJECT_ROOT)/common
+
+COMMON_HEADERS = $(patsubst %, $(COMMON_ROOT)/src/%.h, $(COMMON_LIBS))
+COMMON_OBJECTS = $(patsubst %, $(OBJECTS_DIR)/common_%.o, $(COMMON_LIBS))
+
+INCLUDES += -I$(COMMON_ROOT)/src
+
+$(COMMON_OBJECTS): $(OBJECTS_DIR)/common_%.o: $(COMMON_ROOT)/src/%.cpp $(COMMON_HEADERS) | mkdirs
+	$(CC) -c $(CFLAGS) $(DEFINES) $(INCLUDES) $< -o $@
@@ -0,0 +1,129 @@
+#include "bench_report.h"
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace bench
+{
+    //! Writes a value, without a fraction if it is a whole number
+    static void writeValue(std::ostream& out, double value)
+    {
+        if(value == std::floor(value) && std::fabs(value) < 9e15)
+            out << (long long)value;
+        else
+            out << value;
+    }
+
+    bool parseSizes(const std::string& list, std::vector<uint64_t>& sizes)
+    {
+        sizes.clear();
+
+        std::stringstream in(list);
+        std::string item;
+        while(std::getline(in, item, ','))
+        {
+            if(item.empty()) return false;
+
+            uint64_t scale = 1;
+            switch(toupper(item.back()))
+            {
+                case 'K': scale = 1ULL << 10; break;
+                case 'M': scale = 1ULL << 20; break;
+                case 'G': scale = 1ULL << 30; break;
+            }
+            if(scale != 1) item.pop_back();
+
+            if(item.empty() || item.find_first_not_of("0123456789") != std::string::npos)
+                return false;
+
+            uint64_t size = std::stoull(item) * scale;
+            if(size == 0) return false;
+
+            sizes.push_back(size);
+        }
+
+        return !sizes.empty();
+    }
+
+    double fastest(unsigned reps, const std::function<void()>& run)
+    {
+        double best = 0;
+        for(unsigned i=0; i<reps; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if(i == 0 || seconds < best)
+                best = seconds;
+        }
+        return best;
+    }
+
+    void writeJson(std::ostream& out, const std::vector<result>& results, const std::string& fields)
+    {
+        out << "{\n";
+        if(!fields.empty())
+            out << "  " << fields << ",\n";
+        out << "  \"results\": [";
+        for(size_t i=0; i<results.size(); i++)
+        {
+            const result& r = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"benchmark\": \"" << r.benchmark << "\", \"variant\": \"" << r.variant
+                << "\", \"bytes\": " << r.bytes << ", \"items\": " << r.items << ", \"seconds\": " << r.seconds
+                << ", \"ns_per_item\": " << r.seconds * 1e9 / r.items
+                << ", \"mb_per_s\": " << (r.bytes ? r.bytes / r.seconds / 1e6 : 0) << "}";
+        }
+        out << "\n  ]\n}" << std::endl;
+    }
+
+    void writeCsv(std::ostream& out, const std::vector<result>& results)
+    {
+        out << "benchmark,variant,bytes,items,seconds,ns_per_item,mb_per_s" << std::endl;
+        for(const result& r : results)
+        {
+            out << r.benchmark << "," << r.variant << "," << r.bytes << "," << r.items << "," << r.seconds << ","
+                << r.seconds * 1e9 / r.items << "," << (r.bytes ? r.bytes / r.seconds / 1e6 : 0) << std::endl;
+        }
+    }
+
+    void writeJson(std::ostream& out, const std::vector<record>& records, const std::string& fields)
+    {
+        out << "{\n";
+        if(!fields.empty())
+            out << "  " << fields << ",\n";
+        out << "  \"results\": [";
+        for(size_t i=0; i<records.size(); i++)
+        {
+            out << (i ? ",\n" : "\n") << "    {";
+            for(size_t j=0; j<records[i].size(); j++)
+            {
+                out << (j ? ", \"" : "\"") << records[i][j].first << "\": ";
+                writeValue(out, records[i][j].second);
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}" << std::endl;
+    }
+
+    void writeCsv(std::ostream& out, const std::vector<record>& records)
+    {
+        if(records.empty()) return;
+
+        for(size_t j=0; j<records[0].size(); j++)
+            out << (j ? "," : "") << records[0][j].first;
+        out << std::endl;
+
+        for(const record& r : records)
+        {
+            for(size_t j=0; j<r.size(); j++)
+            {
+                if(j) out << ",";
+                writeValue(out, r[j].second);
+            }
+            out << std::endl;
+        }
+    }
+}
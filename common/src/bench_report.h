@@ -0,0 +1,92 @@
+/*! \file
+
+\brief Timing and reporting shared by the benchmarks
+
+The throughput benchmarks time each measurement with fastest(), collect one result per measurement, and write
+them all at the end with writeJson() or writeCsv(), so every benchmark's output has the same fields and can be
+compared the same way. Benchmarks whose measurements aren't throughput, such as success rates, write records of
+named values instead, laid out the same way.
+*/
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Helpers shared by the benchmarks
+namespace bench
+{
+    //! One measured result
+    struct result
+    {
+        //! What was measured
+        std::string benchmark;
+
+        //! Which implementation, key size, or variant of it
+        std::string variant;
+
+        //! Number of bytes processed; 0 when the measurement isn't of data, such as key setup
+        uint64_t bytes;
+
+        //! Number of blocks or keys processed
+        uint64_t items;
+
+        //! Fastest time for one repetition
+        double seconds;
+    };
+
+    //! A result made of named values, for benchmarks which measure more than time, in the order they are written
+    typedef std::vector<std::pair<std::string, double>> record;
+
+    /*! Parses a comma separated list of positive sizes, each with an optional K, M, or G suffix
+
+        \param[in] list The list
+        \param[out] sizes The sizes
+        \returns bool - Whether or not the list was valid
+    */
+    bool parseSizes(const std::string& list, std::vector<uint64_t>& sizes);
+
+    /*! Runs a function a number of times and times it
+
+        \param[in] reps Number of repetitions
+        \param[in] run The function to time
+        \returns double - The fastest repetition, in seconds
+    */
+    double fastest(unsigned reps, const std::function<void()>& run);
+
+    /*! Writes results as JSON
+
+        \param[in] out Stream to write to
+        \param[in] results The results
+        \param[in] fields Extra fields for the top level object, such as "\"lanes\": 64", written before the results
+    */
+    void writeJson(std::ostream& out, const std::vector<result>& results, const std::string& fields = "");
+
+    /*! Writes results as CSV, one row per result with a header row
+
+        \param[in] out Stream to write to
+        \param[in] results The results
+    */
+    void writeCsv(std::ostream& out, const std::vector<result>& results);
+
+    /*! Writes records as JSON, in the same layout as the results. Whole numbers are written without a fraction
+
+        \param[in] out Stream to write to
+        \param[in] records The records
+        \param[in] fields Extra fields for the top level object, written before the records
+    */
+    void writeJson(std::ostream& out, const std::vector<record>& records, const std::string& fields = "");
+
+    /*! Writes records as CSV, one row per record with a header row taken from the first record's names
+
+        \param[in] out Stream to write to
+        \param[in] records The records
+    */
+    void writeCsv(std::ostream& out, const std::vector<record>& records);
+}
+
+#endif
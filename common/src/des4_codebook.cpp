@@ -0,0 +1,15 @@
+#include "des4_codebook.h"
+
+#include "des4.h"
+
+namespace des4_engine
+{
+    codebook::codebook(uint16_t key, uint16_t rounds)
+    {
+        for(uint16_t block=0; block<BLOCKS; block++)
+        {
+            _encrypt[block] = des4::encrypt(block, key, rounds) & (BLOCKS - 1);
+            _decrypt[block] = des4::decrypt(block, key, rounds) & (BLOCKS - 1);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+/*! \file
+
+\brief Full codebooks for the simplified DES
+
+The simplified DES works on 12-bit blocks, so for a given key and number of rounds there are only 4096 possible
+blocks. Instead of running the rounds for every block, the encryption and decryption of every block are computed
+once with the des4 library and stored in two 4096-entry tables (8 KB each, which fits in the L1 cache). Encrypting
+or decrypting data is then one table lookup per block.
+*/
+#ifndef DES4_CODEBOOK_H
+#define DES4_CODEBOOK_H
+
+#include <cstdint>
+
+namespace des4_engine
+{
+    //! Number of possible keys
+    constexpr int KEYS = 512;
+
+    //! Number of possible blocks
+    constexpr int BLOCKS = 4096;
+
+    //! The encryption and decryption of every block for one key and number of rounds
+    class codebook
+    {
+    public:
+        /*! Builds the tables
+
+            \param[in] key The 9-bit key
+            \param[in] rounds Number of rounds
+        */
+        codebook(uint16_t key, uint16_t rounds);
+
+        //! \returns const uint16_t* - The encryption of each block, indexed by block
+        const uint16_t* encryptTable() const { return _encrypt; }
+
+        //! \returns const uint16_t* - The decryption of each block, indexed by block
+        const uint16_t* decryptTable() const { return _decrypt; }
+
+    private:
+        //! Encryption of each block
+        alignas(64) uint16_t _encrypt[BLOCKS];
+
+        //! Decryption of each block
+        alignas(64) uint16_t _decrypt[BLOCKS];
+    };
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "des4_keysearch.h"
+
+#include <algorithm>
+
+#include "des4.h"
+#include "parallel.h"
+
+using namespace std;
+
+namespace des4_engine
+{
+    //! Number of blocks of the table filled by each chunk of work
+    static const int TABLE_CHUNK_BLOCKS = 64;
+
+    //! A range of blocks of the table to fill
+    struct table_chunk
+    {
+        //! First block of the range
+        int first;
+        //! One past the last block of the range
+        int last;
+
+        table_chunk() : first(0), last(0) {}
+    };
+
+    vector<uint16_t> recoverKeys(const known_pair* pairs, size_t count, uint16_t rounds)
+    {
+        vector<uint16_t> keys;
+        for(uint16_t key=0; key<KEYS; key++)
+        {
+            size_t i = 0;
+            while(i < count && (des4::encrypt(pairs[i].first & (BLOCKS - 1), key, rounds) & (BLOCKS - 1)) == (pairs[i].second & (BLOCKS - 1)))
+                i++;
+
+            if(i == count)
+                keys.push_back(key);
+        }
+        return keys;
+    }
+
+    key_table::key_table(uint16_t rounds, unsigned threads) : _rounds(rounds), _table(BLOCKS * KEYS)
+    {
+        //Each chunk fills its range of blocks in place, so there is nothing to write
+        int next = 0;
+        parallel::ordered<table_chunk>(threads,
+            [&](table_chunk& c)
+            {
+                if(next >= BLOCKS) return false;
+
+                c.first = next;
+                c.last = next = min(BLOCKS, next + TABLE_CHUNK_BLOCKS);
+                return true;
+            },
+            [&](table_chunk& c)
+            {
+                for(int block=c.first; block<c.last; block++)
+                    for(uint16_t key=0; key<KEYS; key++)
+                        _table[block * KEYS + key] = des4::encrypt(block, key, _rounds) & (BLOCKS - 1);
+            },
+            [](table_chunk&)
+            {
+            });
+    }
+
+    vector<uint16_t> key_table::recover(const known_pair* pairs, size_t count) const
+    {
+        //All 1's while the key still matches every pair
+        alignas(64) uint16_t alive[KEYS];
+        for(int k=0; k<KEYS; k++)
+            alive[k] = 0xFFFF;
+
+        for(size_t i=0; i<count; i++)
+        {
+            const uint16_t* row = &_table[(pairs[i].first & (BLOCKS - 1)) * KEYS];
+            uint16_t cipher = pairs[i].second & (BLOCKS - 1);
+
+            uint16_t any = 0;
+            for(int k=0; k<KEYS; k++)
+            {
+                alive[k] &= -(uint16_t)(row[k] == cipher);
+                any |= alive[k];
+            }
+
+            if(!any) break;
+        }
+
+        vector<uint16_t> keys;
+        for(uint16_t k=0; k<KEYS; k++)
+            if(alive[k])
+                keys.push_back(k);
+        return keys;
+    }
+}
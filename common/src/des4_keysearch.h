@@ -0,0 +1,82 @@
+/*! \file
+
+\brief Known-plaintext key recovery for the simplified DES
+
+The simplified DES has a 9-bit key, so there are only 512 keys. Given some plaintext blocks and the ciphertext
+blocks they encrypt to, the key can be recovered by trying every key against every pair; any key which
+encrypts every plaintext to its ciphertext is a candidate. Each pair rules out most of the wrong keys, so a
+handful of pairs is usually enough to leave only the real key.
+
+For a single set of pairs, the keys are tried directly with the des4 library, dropping each key at the first pair
+it gets wrong. For many sets of pairs encrypted with the same number of rounds, a table of the encryption of
+every block under every key is built once with the des4 library. The table is stored block-major, so the 512
+results for one plaintext are contiguous; checking a pair is then a single pass comparing those 512 results with
+the ciphertext, which the compiler vectorizes. The table is filled in chunks of blocks with parallel::ordered.
+
+Both ways reduce the blocks of each pair, and the results of the des4 library, to 12 bits with & (BLOCKS - 1), as the
+codebook does, so they always find the same keys for the same pairs.
+*/
+#ifndef DES4_KEYSEARCH_H
+#define DES4_KEYSEARCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "des4_codebook.h"
+
+namespace des4_engine
+{
+    //! A plaintext block and the ciphertext block it encrypts to
+    typedef std::pair<uint16_t, uint16_t> known_pair;
+
+    /*! Finds every key which encrypts each plaintext to its ciphertext, using the des4 library directly
+
+        \param[in] pairs The known pairs
+        \param[in] count Number of pairs
+        \param[in] rounds Number of rounds the blocks were encrypted with
+        \returns vector<uint16_t> - The keys which match every pair, in increasing order
+    */
+    std::vector<uint16_t> recoverKeys(const known_pair* pairs, size_t count, uint16_t rounds);
+
+    //! The encryption of every block under every key, for one number of rounds
+    class key_table
+    {
+    public:
+        /*! Builds the table
+
+            \param[in] rounds Number of rounds
+            \param[in] threads Number of threads to build the table with
+        */
+        explicit key_table(uint16_t rounds, unsigned threads = 1);
+
+        //! \returns uint16_t - The number of rounds in the table
+        uint16_t rounds() const { return _rounds; }
+
+        /*! Looks up the encryption of a block
+
+            \param[in] block The 12-bit block
+            \param[in] key The 9-bit key
+            \returns uint16_t - The encrypted block
+        */
+        uint16_t encrypt(uint16_t block, uint16_t key) const { return _table[block * KEYS + key]; }
+
+        /*! Finds every key which encrypts each plaintext to its ciphertext
+
+            \param[in] pairs The known pairs
+            \param[in] count Number of pairs
+            \returns vector<uint16_t> - The keys which match every pair, in increasing order
+        */
+        std::vector<uint16_t> recover(const known_pair* pairs, size_t count) const;
+
+    private:
+        //! Number of rounds
+        uint16_t _rounds;
+
+        //! Encryption of each block under each key, block-major
+        std::vector<uint16_t> _table;
+    };
+}
+
+#endif
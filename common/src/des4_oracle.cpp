@@ -0,0 +1,114 @@
+#include "des4_oracle.h"
+#include "des4.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace des4_engine
+{
+    //! Number of blocks written to a pipe oracle before reading its answers
+    constexpr size_t PIPE_GROUP = 1024;
+
+    oracle::oracle() : _queries(0)
+    {
+    }
+
+    uint16_t oracle::encrypt(uint16_t block)
+    {
+        uint16_t out;
+        encrypt(&block, &out, 1);
+        return out;
+    }
+
+    void oracle::encrypt(const uint16_t* blocks, uint16_t* out, size_t count)
+    {
+        query(blocks, out, count);
+        _queries += count;
+    }
+
+    function<uint16_t(uint16_t)> oracle::box()
+    {
+        return [this](uint16_t block){ return encrypt(block); };
+    }
+
+    simulated_oracle::simulated_oracle(uint16_t key, uint16_t rounds) : _key(key), _rounds(rounds)
+    {
+    }
+
+    void simulated_oracle::query(const uint16_t* blocks, uint16_t* out, size_t count)
+    {
+        for(size_t i=0; i<count; i++)
+            out[i] = des4::encrypt(blocks[i] & (BLOCKS - 1), _key, _rounds) & (BLOCKS - 1);
+    }
+
+    pipe_oracle::pipe_oracle(const string& command) : _pid(-1), _to(nullptr), _from(nullptr)
+    {
+        //Created close-on-exec so this end of the pipes stays out of any other commands started later
+        int to[2], from[2];
+        if(pipe2(to, O_CLOEXEC))
+            throw runtime_error("Unable to create pipe");
+        if(pipe2(from, O_CLOEXEC))
+        {
+            ::close(to[0]); ::close(to[1]);
+            throw runtime_error("Unable to create pipe");
+        }
+
+        _pid = fork();
+        if(_pid == 0)
+        {
+            dup2(to[0], STDIN_FILENO);
+            dup2(from[1], STDOUT_FILENO);
+            ::close(to[0]); ::close(to[1]);
+            ::close(from[0]); ::close(from[1]);
+
+            execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+
+        ::close(to[0]);
+        ::close(from[1]);
+        if(_pid < 0)
+        {
+            ::close(to[1]); ::close(from[0]);
+            throw runtime_error("Unable to start " + command);
+        }
+
+        _to = fdopen(to[1], "w");
+        _from = fdopen(from[0], "r");
+    }
+
+    pipe_oracle::~pipe_oracle()
+    {
+        if(_to) fclose(_to);
+        if(_from) fclose(_from);
+        if(_pid > 0) waitpid(_pid, nullptr, 0);
+    }
+
+    void pipe_oracle::query(const uint16_t* blocks, uint16_t* out, size_t count)
+    {
+        for(size_t start=0; start<count; start+=PIPE_GROUP)
+        {
+            size_t end = min(count, start + PIPE_GROUP);
+            for(size_t i=start; i<end; i++)
+                fprintf(_to, "%03x\n", blocks[i] & (BLOCKS - 1));
+
+            if(fflush(_to))
+                throw runtime_error("Oracle stopped accepting blocks");
+
+            for(size_t i=start; i<end; i++)
+            {
+                unsigned block;
+                char line[16];
+                if(!fgets(line, sizeof(line), _from) || sscanf(line, "%3x", &block) != 1 || block >= BLOCKS)
+                    throw runtime_error("Oracle did not answer with 3 hexadecimal digits");
+                out[i] = block;
+            }
+        }
+    }
+}
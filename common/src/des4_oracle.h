@@ -0,0 +1,136 @@
+/*! \file
+
+\brief Encryption oracles for chosen-plaintext attacks on the simplified DES
+
+The differential attacks on the simplified DES (des4::crack3 and des4::crack4) need to have chosen plaintexts
+encrypted with the unknown key. Whatever does that encryption is an oracle. An oracle can be asked for one block
+at a time, which is what the crack functions do through box(), or for many blocks at once, which lets oracles that
+have to talk to something else send all of the blocks before waiting for any of the answers.
+
+Available oracles
+    - simulated_oracle : Holds a hidden key and encrypts with the des4 library, so experiments don't need anything external.
+      An attack asks for few enough blocks that this is cheaper than building a codebook for each key
+    - pipe_oracle : Runs a command and talks to it over pipes. Each block is written to the command's stdin as a line of
+      3 hexadecimal digits, and the command writes each encrypted block to its stdout the same way, in the same order.
+      A program using it should ignore SIGPIPE, so a command which exits early is reported as an error
+
+Every oracle counts the blocks it has been asked to encrypt.
+*/
+#ifndef DES4_ORACLE_H
+#define DES4_ORACLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+
+#include "des4_codebook.h"
+
+namespace des4_engine
+{
+    //! Something which encrypts chosen blocks with a key the attacker doesn't know
+    class oracle
+    {
+    public:
+        oracle();
+        virtual ~oracle() {}
+
+        oracle(const oracle&) = delete;
+        oracle& operator=(const oracle&) = delete;
+
+        /*! Encrypts one block
+
+            \param[in] block The 12-bit block
+            \returns uint16_t - The encrypted block
+        */
+        uint16_t encrypt(uint16_t block);
+
+        /*! Encrypts many blocks at once
+
+            \param[in] blocks The 12-bit blocks
+            \param[out] out The encrypted blocks
+            \param[in] count Number of blocks
+        */
+        void encrypt(const uint16_t* blocks, uint16_t* out, size_t count);
+
+        //! \returns function<uint16_t(uint16_t)> - A box for des4::crack3 and des4::crack4 which asks this oracle
+        std::function<uint16_t(uint16_t)> box();
+
+        //! \returns size_t - Number of blocks encrypted so far
+        size_t queries() const { return _queries; }
+
+    protected:
+        /*! Encrypts a batch of blocks; called by both versions of encrypt
+
+            \param[in] blocks The 12-bit blocks
+            \param[out] out The encrypted blocks
+            \param[in] count Number of blocks
+        */
+        virtual void query(const uint16_t* blocks, uint16_t* out, size_t count) = 0;
+
+    private:
+        //! Blocks encrypted so far
+        size_t _queries;
+    };
+
+    //! Oracle with a hidden key, for testing attacks
+    class simulated_oracle : public oracle
+    {
+    public:
+        /*! Creates an oracle
+
+            \param[in] key The hidden 9-bit key
+            \param[in] rounds Number of rounds to encrypt with
+        */
+        simulated_oracle(uint16_t key, uint16_t rounds);
+
+        //! \returns uint16_t - The hidden key, to check an attack's answer
+        uint16_t key() const { return _key; }
+
+    protected:
+        void query(const uint16_t* blocks, uint16_t* out, size_t count) override;
+
+    private:
+        //! The hidden key
+        uint16_t _key;
+
+        //! Number of rounds
+        uint16_t _rounds;
+    };
+
+    //! Oracle which asks another program
+    class pipe_oracle : public oracle
+    {
+    public:
+        /*! Starts the command with /bin/sh
+
+            \param[in] command The command to run
+            \throws runtime_error - If the command could not be started
+        */
+        explicit pipe_oracle(const std::string& command);
+
+        //! Closes the command's stdin and waits for it to exit
+        ~pipe_oracle();
+
+    protected:
+        /*! Sends the blocks in groups small enough that neither side can fill its pipe while the other is writing
+
+            \throws runtime_error - If the command exits or answers with something other than 3 hexadecimal digits
+        */
+        void query(const uint16_t* blocks, uint16_t* out, size_t count) override;
+
+    private:
+        //! Process id of the command
+        pid_t _pid;
+
+        //! The command's stdin
+        FILE* _to;
+
+        //! The command's stdout
+        FILE* _from;
+    };
+}
+
+#endif
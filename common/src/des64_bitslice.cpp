@@ -0,0 +1,239 @@
+#include "des64_bitslice.h"
+#include "des64_sptable.h"
+#include "des64_tables.h"
+
+namespace des64_engine
+{
+    //! One bit plane
+    typedef uint64_t plane __attribute__((vector_size(8 * DES64_BITSLICE_LANES)));
+
+    /*! Transposes a 64x64 bit matrix in place; bit j of row i (counting from the most significant)
+        becomes bit i of row j
+
+        \param[in,out] m The 64 rows of the matrix
+    */
+    static void transpose(uint64_t* m)
+    {
+        uint64_t mask = 0x00000000FFFFFFFFULL;
+        for(int j=32; j; j >>= 1, mask ^= mask << j)
+        {
+            for(int k=0; k<64; k = ((k | j) + 1) & ~j)
+            {
+                uint64_t t = (m[k] ^ (m[k | j] >> j)) & mask;
+                m[k] ^= t;
+                m[k | j] ^= t << j;
+            }
+        }
+    }
+
+    //! OR of the column minterms for which output BIT of S-box BOX is set in row ROW; COL counts down to -1
+    template<int BOX, int ROW, int BIT, int COL>
+    struct column_sum
+    {
+        static inline plane eval(const plane* col)
+        {
+            return ((tables::S[BOX][ROW*16 + COL] >> (3 - BIT)) & 1) ?
+                    (column_sum<BOX, ROW, BIT, COL-1>::eval(col) | col[COL]) :
+                     column_sum<BOX, ROW, BIT, COL-1>::eval(col);
+        }
+    };
+
+    //! Empty sum
+    template<int BOX, int ROW, int BIT>
+    struct column_sum<BOX, ROW, BIT, -1>
+    {
+        static inline plane eval(const plane*) { return plane{}; }
+    };
+
+    /*! Evaluates one output bit of an S-box
+
+        \param[in] row The 4 row minterms
+        \param[in] col The 16 column minterms
+        \returns plane - The output bit for every block
+    */
+    template<int BOX, int BIT>
+    static inline plane sboxBit(const plane* row, const plane* col)
+    {
+        return (row[0] & column_sum<BOX, 0, BIT, 15>::eval(col)) |
+               (row[1] & column_sum<BOX, 1, BIT, 15>::eval(col)) |
+               (row[2] & column_sum<BOX, 2, BIT, 15>::eval(col)) |
+               (row[3] & column_sum<BOX, 3, BIT, 15>::eval(col));
+    }
+
+    /*! Evaluates an S-box
+
+        \param[in] x The 6 input bits, most significant first
+        \param[out] out The 4 output bits, most significant first
+    */
+    template<int BOX>
+    static inline void sbox(const plane* x, plane* out)
+    {
+        //Row is the outer bits, column is the inner bits
+        plane n0 = ~x[0], n5 = ~x[5];
+        plane row[4] = {n0 & n5, n0 & x[5], x[0] & n5, x[0] & x[5]};
+
+        plane n1 = ~x[1], n2 = ~x[2], n3 = ~x[3], n4 = ~x[4];
+        plane hi[4] = {n1 & n2, n1 & x[2], x[1] & n2, x[1] & x[2]};
+        plane lo[4] = {n3 & n4, n3 & x[4], x[3] & n4, x[3] & x[4]};
+
+        plane col[16];
+        for(int i=0; i<16; i++)
+            col[i] = hi[i >> 2] & lo[i & 3];
+
+        out[0] = sboxBit<BOX, 0>(row, col);
+        out[1] = sboxBit<BOX, 1>(row, col);
+        out[2] = sboxBit<BOX, 2>(row, col);
+        out[3] = sboxBit<BOX, 3>(row, col);
+    }
+
+    /*! The DES round function on bit planes
+
+        \param[in] right The 32 planes of the right half
+        \param[in] key The 48 key bits for this round; masks which are all 1's or all 0's when every
+                       block uses the same key, or planes when each block has its own key
+        \param[in,out] left The 32 planes of the left half, which f(right, key) is XOR'ed into
+    */
+    template<class Key>
+    static inline void feistel(const plane* right, const Key* key, plane* left)
+    {
+        plane x[48];
+        for(int i=0; i<48; i++)
+            x[i] = right[tables::E[i] - 1] ^ key[i];
+
+        plane s[32];
+        sbox<0>(x, s);
+        sbox<1>(x + 6, s + 4);
+        sbox<2>(x + 12, s + 8);
+        sbox<3>(x + 18, s + 12);
+        sbox<4>(x + 24, s + 16);
+        sbox<5>(x + 30, s + 20);
+        sbox<6>(x + 36, s + 24);
+        sbox<7>(x + 42, s + 28);
+
+        for(int i=0; i<32; i++)
+            left[i] ^= s[tables::P[i] - 1];
+    }
+
+    void processBitslice(uint64_t* blocks, const round_keys& keys, int stages)
+    {
+        //Each round key bit becomes a mask that is XOR'ed with a whole plane
+        int rounds = stages * ROUNDS;
+        uint64_t masks[MAX_STAGES*ROUNDS][48];
+        for(int r=0; r<rounds; r++)
+            for(int i=0; i<48; i++)
+                masks[r][i] = 0 - ((keys[r] >> (47 - i)) & 1);
+
+        //Transpose each group of 64 blocks into one lane of the planes
+        plane in[64];
+        uint64_t m[64];
+        for(int l=0; l<DES64_BITSLICE_LANES; l++)
+        {
+            for(int i=0; i<64; i++) m[i] = blocks[64*l + i];
+            transpose(m);
+            for(int i=0; i<64; i++) in[i][l] = m[i];
+        }
+
+        plane halves[2][32];
+        for(int i=0; i<32; i++)
+        {
+            halves[0][i] = in[tables::IP[i] - 1];
+            halves[1][i] = in[tables::IP[32 + i] - 1];
+        }
+
+        //Halves alternate instead of being swapped. Between stages the halves
+        //trade places, so every other stage starts by updating halves[1]
+        for(int r=0; r<rounds; r++)
+        {
+            int target = (r + r / ROUNDS) & 1;
+            feistel(halves[target ^ 1], masks[r], halves[target]);
+        }
+
+        //After an odd number of stages, the last round wrote the right half into halves[1]; it goes first
+        plane* pre = in;
+        for(int i=0; i<32; i++)
+        {
+            pre[i] = halves[1][i];
+            pre[32 + i] = halves[0][i];
+        }
+
+        plane out[64];
+        for(int i=0; i<64; i++)
+            out[i] = pre[tables::FP[i] - 1];
+
+        for(int l=0; l<DES64_BITSLICE_LANES; l++)
+        {
+            for(int i=0; i<64; i++) m[i] = out[i][l];
+            transpose(m);
+            for(int i=0; i<64; i++) blocks[64*l + i] = m[i];
+        }
+    }
+
+    void searchBitslice(const uint64_t* keyBits, uint64_t plain, uint64_t cipher, uint64_t* found)
+    {
+        plane key[64];
+        for(int i=0; i<64; i++)
+            for(int l=0; l<DES64_BITSLICE_LANES; l++)
+                key[i][l] = keyBits[i*DES64_BITSLICE_LANES + l];
+
+        //Every block is the same plaintext, so its planes are all 1's or all 0's
+        uint64_t in = permute(plain, tables::IP, 64, 64);
+        plane halves[2][32];
+        for(int i=0; i<32; i++)
+        {
+            halves[0][i] = plane{} - (uint64_t)((in >> (63 - i)) & 1);
+            halves[1][i] = plane{} - (uint64_t)((in >> (31 - i)) & 1);
+        }
+
+        //The final permutation is undone on the ciphertext instead of applied to every block
+        uint64_t out = permute(cipher, tables::IP, 64, 64);
+
+        plane round[48];
+        for(int r=0; r<ROUNDS-1; r++)
+        {
+            for(int i=0; i<48; i++)
+                round[i] = key[tables::ROUND_KEY_BITS.bits[r][i] - 1];
+            feistel(halves[(r & 1) ^ 1], round, halves[r & 1]);
+        }
+
+        //The left half of the output is the right half going into the last round,
+        //so most keys can be ruled out without running it
+        plane mismatch = plane{};
+        for(int i=0; i<32; i++)
+            mismatch |= halves[0][i] ^ (0 - ((out >> (31 - i)) & 1));
+
+        bool any = false;
+        for(int l=0; l<DES64_BITSLICE_LANES; l++)
+            any = any || ~mismatch[l];
+
+        if(any)
+        {
+            for(int i=0; i<48; i++)
+                round[i] = key[tables::ROUND_KEY_BITS.bits[ROUNDS-1][i] - 1];
+            feistel(halves[0], round, halves[1]);
+
+            for(int i=0; i<32; i++)
+                mismatch |= halves[1][i] ^ (0 - ((out >> (63 - i)) & 1));
+        }
+
+        for(int l=0; l<DES64_BITSLICE_LANES; l++)
+            found[l] = ~mismatch[l];
+    }
+
+    void encryptBlocksBS(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        size_t full = count - count % BITSLICE_BLOCKS;
+        for(size_t i=0; i<full; i+=BITSLICE_BLOCKS)
+            processBitslice(blocks + i, keys.encryptKeys(), keys.stages());
+
+        encryptBlocksSP(blocks + full, count - full, keys);
+    }
+
+    void decryptBlocksBS(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        size_t full = count - count % BITSLICE_BLOCKS;
+        for(size_t i=0; i<full; i+=BITSLICE_BLOCKS)
+            processBitslice(blocks + i, keys.decryptKeys(), keys.stages());
+
+        decryptBlocksSP(blocks + full, count - full, keys);
+    }
+}
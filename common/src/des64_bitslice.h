@@ -0,0 +1,89 @@
+/*! \file
+
+\brief Bitsliced implementation of the 64-bit DES
+
+Instead of processing one block at a time, a bitsliced implementation processes a batch of
+blocks at once by transposing them into bit planes: plane i holds bit i of every block in the batch,
+one block per bit of the plane. Each DES operation is then applied to all of the blocks simultaneously
+    - Permutations (IP, E, P, FP) just pick which plane to use; they cost nothing
+    - XORs with the round key and the left half are one XOR per plane
+    - S-boxes are evaluated as networks of AND, OR and NOT on the planes
+
+Each S-box is evaluated by building the 16 minterms of the 4 column bits and the 4 minterms of the
+2 row bits once, then each output bit is the OR of the column minterms where that output bit is set,
+selected by the row minterm. The networks are generated from the S-box tables at compile time.
+
+A plane is 64 bits wide on any platform. When compiled with SSE2 or AVX2 enabled, the planes are
+vectors of 2 or 4 64-bit words and a batch is 128 or 256 blocks.
+
+For triple DES, the initial and final permutations between stages cancel out, and the halves
+trade places by changing which one each round updates.
+
+Arrays which are not a multiple of the batch size have their remaining blocks processed with the
+SP-table implementation.
+
+The same networks can also run a batch of different keys on one block, for key search. Then the planes
+of the block are constant, and the key is a set of planes instead; each round key bit is just one of the
+key's planes. Since the left half of the output is the right half going into the last round, keys are
+checked against it after 15 rounds, and the last round only runs if some key in the batch still matches.
+*/
+#ifndef DES64_BITSLICE_H
+#define DES64_BITSLICE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "des64_keyschedule.h"
+
+//! Number of 64-bit words in a bitsliced plane
+#if defined(__AVX2__)
+#define DES64_BITSLICE_LANES 4
+#elif defined(__SSE2__)
+#define DES64_BITSLICE_LANES 2
+#else
+#define DES64_BITSLICE_LANES 1
+#endif
+
+namespace des64_engine
+{
+    //! Number of blocks processed together by the bitsliced implementation
+    constexpr size_t BITSLICE_BLOCKS = 64 * DES64_BITSLICE_LANES;
+
+    /*! Runs each stage of the DES on a batch of BITSLICE_BLOCKS blocks in place
+
+        \param[in,out] blocks The blocks to process
+        \param[in] keys The round keys, in the order they should be used
+        \param[in] stages Number of 16-round stages in keys
+    */
+    void processBitslice(uint64_t* blocks, const round_keys& keys, int stages);
+
+    /*! Encrypts an array of blocks in place; full batches are bitsliced
+
+        \param[in,out] blocks The blocks to encrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to encrypt with
+    */
+    void encryptBlocksBS(uint64_t* blocks, size_t count, const key_schedule& keys);
+
+    /*! Decrypts an array of blocks in place; full batches are bitsliced
+
+        \param[in,out] blocks The blocks to decrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to decrypt with
+    */
+    void decryptBlocksBS(uint64_t* blocks, size_t count, const key_schedule& keys);
+
+    /*! Encrypts one block with a batch of BITSLICE_BLOCKS keys and finds which keys give the expected ciphertext
+
+        Keys are given as planes, DES64_BITSLICE_LANES words per key bit; bit j of word l of a plane
+        belongs to key 64*l + j. Planes for parity bits are ignored.
+
+        \param[in] keyBits The 64 key bit planes, most significant key bit first
+        \param[in] plain The plaintext block
+        \param[in] cipher The expected ciphertext block
+        \param[out] found DES64_BITSLICE_LANES words with a bit set for each key which encrypts plain to cipher
+    */
+    void searchBitslice(const uint64_t* keyBits, uint64_t plain, uint64_t cipher, uint64_t* found);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "des64_engine.h"
+#include "des64_sptable.h"
+#include "des64_bitslice.h"
+
+namespace des64_engine
+{
+    bool backendFromName(const std::string& name, backend& out)
+    {
+        if(name == "reference")
+            out = backend::Reference;
+        else if(name == "sp")
+            out = backend::SPTable;
+        else if(name == "bitslice")
+            out = backend::Bitslice;
+        else
+            return false;
+
+        return true;
+    }
+
+    block_function encryptFunction(backend b)
+    {
+        switch(b)
+        {
+            case backend::Reference: return encryptBlocks;
+            case backend::SPTable: return encryptBlocksSP;
+            default: return encryptBlocksBS;
+        }
+    }
+
+    block_function decryptFunction(backend b)
+    {
+        switch(b)
+        {
+            case backend::Reference: return decryptBlocks;
+            case backend::SPTable: return decryptBlocksSP;
+            default: return decryptBlocksBS;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*! \file
+
+\brief Selection between the available 64-bit DES implementations
+
+All implementations produce identical output; they only differ in speed.
+    - reference : Bit-by-bit permutations and separate S-box and P steps, following the specification directly
+    - sp : Fused S-box/P tables and swap-move initial and final permutations (see des64_sptable.h)
+    - bitslice : Batches of blocks transposed into bit planes, S-boxes evaluated as gate networks (see des64_bitslice.h)
+
+The default implementation is bitslice, unless DES64_REFERENCE is defined at compile time.
+*/
+#ifndef DES64_ENGINE_H
+#define DES64_ENGINE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "des64_keyschedule.h"
+
+namespace des64_engine
+{
+    //! Available implementations
+    enum class backend{Reference, SPTable, Bitslice};
+
+    //! Function which encrypts or decrypts an array of blocks in place
+    typedef void (*block_function)(uint64_t*, size_t, const key_schedule&);
+
+    //! The implementation used when none is requested
+#ifdef DES64_REFERENCE
+    constexpr backend DEFAULT_BACKEND = backend::Reference;
+#else
+    constexpr backend DEFAULT_BACKEND = backend::Bitslice;
+#endif
+
+    /*! Looks up an implementation by name
+
+        \param[in] name Name of the implementation; one of reference, sp, bitslice
+        \param[out] out The implementation
+        \returns bool - Whether or not the name was valid
+    */
+    bool backendFromName(const std::string& name, backend& out);
+
+    /*! Gets the bulk encryption function for an implementation
+
+        \param[in] b The implementation
+        \returns block_function - Function which encrypts arrays of blocks
+    */
+    block_function encryptFunction(backend b);
+
+    /*! Gets the bulk decryption function for an implementation
+
+        \param[in] b The implementation
+        \returns block_function - Function which decrypts arrays of blocks
+    */
+    block_function decryptFunction(backend b);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "des64_keyschedule.h"
+#include "des64_tables.h"
+
+#include <stdexcept>
+
+namespace des64_engine
+{
+    /*! The DES round function
+
+        \param[in] right The 32-bit right half of the block
+        \param[in] key The 48-bit round key
+        \returns uint32_t - f(right, key)
+    */
+    static uint32_t feistel(uint32_t right, uint64_t key)
+    {
+        uint64_t x = permute(right, tables::E, 48, 32) ^ key;
+
+        uint32_t s = 0;
+        for(int i=0; i<8; i++)
+        {
+            //Outer bits pick the row, inner bits pick the column
+            uint8_t six = (x >> (42 - 6*i)) & 0x3F;
+            uint8_t row = ((six >> 4) & 0x2) | (six & 0x1);
+            uint8_t col = (six >> 1) & 0xF;
+            s = (s << 4) | tables::S[i][row*16 + col];
+        }
+
+        return permute(s, tables::P, 32, 32);
+    }
+
+    bool parityValid(uint64_t key)
+    {
+        for(int i=0; i<8; i++)
+        {
+            uint8_t byte = (key >> (8*i)) & 0xFF;
+            byte ^= byte >> 4;
+            byte ^= byte >> 2;
+            byte ^= byte >> 1;
+            if(!(byte & 1))
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t setParity(uint64_t key)
+    {
+        for(int i=0; i<8; i++)
+        {
+            uint8_t byte = (key >> (8*i)) & 0xFE;
+            byte ^= byte >> 4;
+            byte ^= byte >> 2;
+            byte ^= byte >> 1;
+            key = (key & ~(1ULL << (8*i))) | ((uint64_t)(~byte & 1) << (8*i));
+        }
+        return key;
+    }
+
+    /*! Splits a 48-bit round key into the 8 6-bit values used by each S-box, and
+        packs them into two words in the order the SP-table rounds consume them.
+        S-boxes 1, 3, 5, 7 go in the first word and S-boxes 2, 4, 6, 8 go in the second,
+        each one byte apart.
+
+        \param[in] key The 48-bit round key
+        \param[out] cooked The two words to write
+    */
+    static void cook(uint64_t key, uint32_t* cooked)
+    {
+        uint32_t k[8];
+        for(int j=0; j<8; j++)
+            k[j] = (key >> (42 - 6*j)) & 0x3F;
+
+        cooked[0] = (k[0] << 24) | (k[2] << 16) | (k[4] << 8) | k[6];
+        cooked[1] = (k[1] << 24) | (k[3] << 16) | (k[5] << 8) | k[7];
+    }
+
+    /*! Generates the 16 round keys for a single DES key
+
+        Each round key is selected straight from the key with tables::ROUND_KEY_BITS, which already
+        has PC-1, the rotations, and PC-2 folded into it.
+
+        \param[in] key The 64-bit key
+        \param[out] out Where to write the round keys
+    */
+    static void expand(uint64_t key, uint64_t* out)
+    {
+        for(int i=0; i<ROUNDS; i++)
+            out[i] = permute(key, tables::ROUND_KEY_BITS.bits[i], 48, 64);
+    }
+
+    key_schedule::key_schedule(uint64_t key) : _stages(1), _keys{{key, 0, 0}}
+    {
+        generate();
+    }
+
+    key_schedule::key_schedule(uint64_t key1, uint64_t key2, uint64_t key3) : _stages(3), _keys{{key1, key2, key3}}
+    {
+        generate();
+    }
+
+    void key_schedule::generate()
+    {
+        for(int s=0; s<_stages; s++)
+        {
+            if(!parityValid(_keys[s]))
+                throw std::logic_error("Key parity fails");
+
+            uint64_t keys[ROUNDS];
+            expand(_keys[s], keys);
+
+            //Middle stage of EDE decrypts, so its keys are reversed
+            for(int i=0; i<ROUNDS; i++)
+                _encrypt[s*ROUNDS + i] = (s % 2 ? keys[ROUNDS-1-i] : keys[i]);
+        }
+
+        int total = _stages * ROUNDS;
+        for(int i=0; i<total; i++)
+        {
+            _decrypt[i] = _encrypt[total-1-i];
+            cook(_encrypt[i], &_encryptCooked[2*i]);
+            cook(_decrypt[i], &_decryptCooked[2*i]);
+        }
+    }
+
+    uint64_t process(uint64_t block, const round_keys& keys, int stages)
+    {
+        for(int s=0; s<stages; s++)
+        {
+            block = permute(block, tables::IP, 64, 64);
+
+            uint32_t left = block >> 32;
+            uint32_t right = block & 0xFFFFFFFF;
+            for(int i=0; i<ROUNDS; i++)
+            {
+                uint32_t next = left ^ feistel(right, keys[s*ROUNDS + i]);
+                left = right;
+                right = next;
+            }
+
+            //Halves are not swapped after the last round
+            block = permute(((uint64_t)right << 32) | left, tables::FP, 64, 64);
+        }
+
+        return block;
+    }
+
+    void encryptBlocks(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        for(size_t i=0; i<count; i++)
+            blocks[i] = process(blocks[i], keys.encryptKeys(), keys.stages());
+    }
+
+    void decryptBlocks(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        for(size_t i=0; i<count; i++)
+            blocks[i] = process(blocks[i], keys.decryptKeys(), keys.stages());
+    }
+}
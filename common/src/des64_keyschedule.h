@@ -0,0 +1,170 @@
+/*! \file
+
+\brief Precomputed key schedule for the 64-bit DES
+
+Every round of the DES uses a 48-bit sub-key which is generated from the 64-bit key by
+permuting it with PC-1, rotating the two 28-bit halves, and selecting 48 of the bits with PC-2.
+None of this depends on the data being processed, so when a large number of blocks are encrypted
+with the same key, the parity check and sub-key generation only need to happen once.
+
+A key_schedule stores the 16 round keys in encryption order, as well as in reverse order for
+decryption, so that blocks can be processed without touching the original key again. Each round
+key is also stored pre-split into the two 32-bit words used by the SP-table implementation (see
+des64_sptable.h).
+
+\section ede_keyschedule Triple DES
+A key_schedule can also be made from three keys for triple DES in encrypt-decrypt-encrypt (EDE) form,
+\f$ C = E_{K_3}(D_{K_2}(E_{K_1}(P))) \f$. Two-key triple DES uses \f$ K_3 = K_1 \f$. In that case the schedule
+has 3 stages of 16 rounds, and the 48 round keys are stored in the order they are used: \f$ K_1 \f$'s keys forward,
+\f$ K_2 \f$'s keys reversed, and \f$ K_3 \f$'s keys forward. Decryption, \f$ P = D_{K_1}(E_{K_2}(D_{K_3}(C))) \f$, uses
+the exact reverse of that list.
+
+Since the final permutation of one stage is immediately undone by the initial permutation of the next,
+the fast implementations skip both and only swap the halves between stages, so triple DES costs 48 rounds
+plus a single IP and FP.
+*/
+#ifndef DES64_KEYSCHEDULE_H
+#define DES64_KEYSCHEDULE_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+//! DES implementation details which are shared between the tools
+namespace des64_engine
+{
+    //! Number of rounds in the DES
+    constexpr int ROUNDS = 16;
+
+    //! Maximum number of DES stages in a schedule; 3 for triple DES
+    constexpr int MAX_STAGES = 3;
+
+    //! Set of round keys, one for each round of every stage
+    typedef std::array<uint64_t, MAX_STAGES*ROUNDS> round_keys;
+
+    //! Set of round keys split into two 32-bit words per round for the SP-table implementation
+    typedef std::array<uint32_t, 2*MAX_STAGES*ROUNDS> cooked_keys;
+
+    //! Round keys for a single DES key or a triple DES key set, in encryption and decryption order
+    class key_schedule
+    {
+    public:
+        /*! Checks the key parity and generates all the round keys for single DES
+
+            \param[in] key The 64-bit DES key
+            \throws logic_error : The key parity check fails
+        */
+        explicit key_schedule(uint64_t key);
+
+        /*! Checks the key parities and generates all the round keys for triple DES (EDE)
+
+            \param[in] key1 The key for the first encryption
+            \param[in] key2 The key for the decryption
+            \param[in] key3 The key for the last encryption; same as key1 for two-key triple DES
+            \throws logic_error : The key parity check fails for any of the keys
+        */
+        key_schedule(uint64_t key1, uint64_t key2, uint64_t key3);
+
+        //! \returns int - Number of DES stages; 1 for single DES, 3 for triple DES
+        int stages() const { return _stages; }
+
+        /*! \param[in] stage Which stage's key to get
+            \returns uint64_t - The key the stage was generated from
+        */
+        uint64_t key(int stage = 0) const { return _keys[stage]; }
+
+        //! \returns round_keys - The 48-bit round keys in the order they are used for encryption
+        const round_keys& encryptKeys() const { return _encrypt; }
+
+        //! \returns round_keys - The 48-bit round keys in the order they are used for decryption
+        const round_keys& decryptKeys() const { return _decrypt; }
+
+        //! \returns cooked_keys - The encryption round keys in SP-table form
+        const cooked_keys& encryptCooked() const { return _encryptCooked; }
+
+        //! \returns cooked_keys - The decryption round keys in SP-table form
+        const cooked_keys& decryptCooked() const { return _decryptCooked; }
+
+    private:
+        /*! Generates the round keys for all stages from _keys */
+        void generate();
+
+        //! Number of stages
+        int _stages;
+
+        //! The original keys, one for each stage
+        std::array<uint64_t, MAX_STAGES> _keys;
+
+        //! Round keys for encryption
+        round_keys _encrypt;
+
+        //! Round keys for decryption; _encrypt reversed
+        round_keys _decrypt;
+
+        //! _encrypt in SP-table form
+        cooked_keys _encryptCooked;
+
+        //! _decrypt in SP-table form
+        cooked_keys _decryptCooked;
+    };
+
+    /*! Checks that every byte of a key has an odd number of 1's in it
+
+        \param[in] key The key to check
+        \returns bool - Whether or not the key passes the parity check
+    */
+    bool parityValid(uint64_t key);
+
+    /*! Sets the lowest bit of every byte of a key so that the key passes the parity check
+
+        \param[in] key The key to fix
+        \returns uint64_t - The key with valid parity
+    */
+    uint64_t setParity(uint64_t key);
+
+    /*! Runs each stage of the DES on a block with the given round keys
+
+        Encryption and decryption only differ by the order of the round keys.
+        Each stage is a complete DES, including the initial and final permutations.
+
+        \param[in] block The block to process
+        \param[in] keys The round keys, in the order they should be used
+        \param[in] stages Number of 16-round stages in keys
+        \returns uint64_t - The processed block
+    */
+    uint64_t process(uint64_t block, const round_keys& keys, int stages);
+
+    /*! Encrypts a single block
+
+        \param[in] block The block to encrypt
+        \param[in] keys The key schedule to encrypt with
+        \returns uint64_t - The encrypted block
+    */
+    inline uint64_t encrypt(uint64_t block, const key_schedule& keys) { return process(block, keys.encryptKeys(), keys.stages()); }
+
+    /*! Decrypts a single block
+
+        \param[in] block The block to decrypt
+        \param[in] keys The key schedule to decrypt with
+        \returns uint64_t - The decrypted block
+    */
+    inline uint64_t decrypt(uint64_t block, const key_schedule& keys) { return process(block, keys.decryptKeys(), keys.stages()); }
+
+    /*! Encrypts an array of blocks in place
+
+        \param[in,out] blocks The blocks to encrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to encrypt with
+    */
+    void encryptBlocks(uint64_t* blocks, size_t count, const key_schedule& keys);
+
+    /*! Decrypts an array of blocks in place
+
+        \param[in,out] blocks The blocks to decrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to decrypt with
+    */
+    void decryptBlocks(uint64_t* blocks, size_t count, const key_schedule& keys);
+}
+
+#endif
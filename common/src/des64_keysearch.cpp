@@ -0,0 +1,116 @@
+#include "des64_keysearch.h"
+#include "des64_keyschedule.h"
+#include "des64_bitslice.h"
+
+namespace des64_engine
+{
+    //! Number of index bits which pick the key within a bitsliced batch
+    constexpr int BATCH_BITS = (BITSLICE_BLOCKS == 256 ? 8 : BITSLICE_BLOCKS == 128 ? 7 : 6);
+
+    //! Key bits which are not parity bits
+    constexpr uint64_t KEY_BITS = 0xFEFEFEFEFEFEFEFEULL;
+
+    //! Planes for the 6 index bits which pick the key within a word
+    static const uint64_t WORD_PATTERNS[6] = {0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+                                              0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+
+    key_space::key_space(uint64_t base, uint64_t mask) : _mask(mask & KEY_BITS)
+    {
+        _complemented = (_mask == KEY_BITS);
+        _base = base & ~_mask;
+
+        //With complements, the most significant key bit stays 0
+        for(int i=63; i>=(_complemented ? 1 : 0); i--)
+            if((_mask >> (63 - i)) & 1)
+                _positions.push_back(i);
+
+        _size = 1ULL << _positions.size();
+    }
+
+    uint64_t key_space::key(uint64_t index) const
+    {
+        uint64_t key = _base;
+        for(size_t j=0; j<_positions.size(); j++)
+            key |= ((index >> j) & 1) << (63 - _positions[j]);
+        return setParity(key);
+    }
+
+    bool key_space::tryIndex(uint64_t index, uint64_t plain, uint64_t cipher, uint64_t& found) const
+    {
+        uint64_t k = key(index);
+        key_schedule schedule(k);
+        if(encrypt(plain, schedule) == cipher)
+        {
+            found = k;
+            return true;
+        }
+
+        //Complementing every byte keeps its parity odd
+        if(_complemented && encrypt(~plain, schedule) == ~cipher)
+        {
+            found = ~k;
+            return true;
+        }
+        return false;
+    }
+
+    bool key_space::search(uint64_t plain, uint64_t cipher, uint64_t start, uint64_t end, uint64_t& found) const
+    {
+        if(end > _size) end = _size;
+        if(start >= end) return false;
+
+        //Too few unknown bits to fill a batch
+        if(bits() < BATCH_BITS)
+        {
+            for(uint64_t i=start; i<end; i++)
+                if(tryIndex(i, plain, cipher, found)) return true;
+            return false;
+        }
+
+        uint64_t first = (start + BITSLICE_BLOCKS - 1) & ~(uint64_t)(BITSLICE_BLOCKS - 1);
+        uint64_t last = end & ~(uint64_t)(BITSLICE_BLOCKS - 1);
+        if(first > last) first = last = end;
+
+        for(uint64_t i=start; i<first; i++)
+            if(tryIndex(i, plain, cipher, found)) return true;
+
+        //Known bits and the bits within the batch stay the same for every batch
+        uint64_t keyBits[64 * DES64_BITSLICE_LANES];
+        for(int i=0; i<64; i++)
+            for(int l=0; l<DES64_BITSLICE_LANES; l++)
+                keyBits[i*DES64_BITSLICE_LANES + l] = 0 - ((_base >> (63 - i)) & 1);
+
+        for(int j=0; j<BATCH_BITS; j++)
+            for(int l=0; l<DES64_BITSLICE_LANES; l++)
+                keyBits[_positions[j]*DES64_BITSLICE_LANES + l] = (j < 6 ? WORD_PATTERNS[j] : 0 - (uint64_t)((l >> (j - 6)) & 1));
+
+        uint64_t matches[DES64_BITSLICE_LANES];
+        for(uint64_t batch=first; batch<last; batch+=BITSLICE_BLOCKS)
+        {
+            for(size_t j=BATCH_BITS; j<_positions.size(); j++)
+            {
+                uint64_t bit = 0 - ((batch >> j) & 1);
+                for(int l=0; l<DES64_BITSLICE_LANES; l++)
+                    keyBits[_positions[j]*DES64_BITSLICE_LANES + l] = bit;
+            }
+
+            for(int pass=0; pass<(_complemented ? 2 : 1); pass++)
+            {
+                searchBitslice(keyBits, pass ? ~plain : plain, pass ? ~cipher : cipher, matches);
+                for(int l=0; l<DES64_BITSLICE_LANES; l++)
+                {
+                    if(!matches[l]) continue;
+
+                    uint64_t k = key(batch + 64*l + __builtin_ctzll(matches[l]));
+                    found = (pass ? ~k : k);
+                    return true;
+                }
+            }
+        }
+
+        for(uint64_t i=last; i<end; i++)
+            if(tryIndex(i, plain, cipher, found)) return true;
+
+        return false;
+    }
+}
@@ -0,0 +1,100 @@
+/*! \file
+
+\brief Known-plaintext key search for the 64-bit DES
+
+Given a plaintext block and the ciphertext block it encrypts to, the key can be found by trying every key.
+Only 56 of the 64 key bits are used, so there are \f$ 2^{56} \f$ keys. Part of the key may already be known;
+a key space is the set of keys made by filling the unknown bits (given as a mask) of a base key with every
+possible combination. Each combination has an index, whose bits are placed into the unknown bits in order,
+least significant first, so a range of indices is a piece of the key space which can be searched separately.
+
+The DES has the complementation property: \f$ E_{\bar{K}}(\bar{P}) = \overline{E_K(P)} \f$. When every key bit
+is unknown, the highest one is fixed at 0 and each key \f$ K \f$ is also checked by encrypting \f$ \bar{P} \f$
+and comparing with \f$ \bar{C} \f$; a match means \f$ \bar{K} \f$ is the key. This halves the number of indices.
+
+Keys are tried in batches of BITSLICE_BLOCKS with the bitsliced implementation; the low bits of the index
+pick the key within the batch, so the key planes for those bits are fixed patterns and the rest are all 1's
+or all 0's. Indices at the edges of a range which don't fill a batch are tried one at a time.
+*/
+#ifndef DES64_KEYSEARCH_H
+#define DES64_KEYSEARCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace des64_engine
+{
+    //! A set of keys sharing some known bits
+    class key_space
+    {
+    public:
+        /*! Creates a key space
+
+            \param[in] base Key holding the known bits
+            \param[in] mask Bits of the key which are unknown. Parity bits are ignored
+        */
+        key_space(uint64_t base, uint64_t mask);
+
+        //! \returns uint64_t - Number of indices in the key space
+        uint64_t size() const { return _size; }
+
+        //! \returns int - Number of unknown bits that the index fills
+        int bits() const { return (int)_positions.size(); }
+
+        //! \returns bool - Whether each index also covers its complement key
+        bool complemented() const { return _complemented; }
+
+        //! \returns uint64_t - The base key, with the unknown bits cleared
+        uint64_t base() const { return _base; }
+
+        //! \returns uint64_t - The unknown bits
+        uint64_t mask() const { return _mask; }
+
+        /*! Gets the key for an index
+
+            \param[in] index Index of the key; less than size()
+            \returns uint64_t - The key, with valid parity
+        */
+        uint64_t key(uint64_t index) const;
+
+        /*! Searches a range of indices for the key which encrypts a block to another
+
+            \param[in] plain The plaintext block
+            \param[in] cipher The ciphertext block
+            \param[in] start First index to try
+            \param[in] end One past the last index to try
+            \param[out] found The key, with valid parity, if one was found
+            \returns bool - Whether a key was found. The first one found is returned
+        */
+        bool search(uint64_t plain, uint64_t cipher, uint64_t start, uint64_t end, uint64_t& found) const;
+
+    private:
+        /*! Tries one index
+
+            \param[in] index The index
+            \param[in] plain The plaintext block
+            \param[in] cipher The ciphertext block
+            \param[out] found The key, if it matched
+            \returns bool - Whether the key or its complement matched
+        */
+        bool tryIndex(uint64_t index, uint64_t plain, uint64_t cipher, uint64_t& found) const;
+
+        //! Known bits of the key
+        uint64_t _base;
+
+        //! Unknown bits of the key, without parity bits
+        uint64_t _mask;
+
+        //! Key bit (counting from the most significant) for each bit of the index, least significant first
+        std::vector<int> _positions;
+
+        //! Number of indices
+        uint64_t _size;
+
+        //! Whether complements are checked too
+        bool _complemented;
+    };
+}
+
+#endif
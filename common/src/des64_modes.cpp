@@ -0,0 +1,193 @@
+#include "des64_modes.h"
+#include "des64_sptable.h"
+#include "des64_bitslice.h"
+
+namespace des64_engine
+{
+    bool modeFromName(const std::string& name, cipher_mode& out)
+    {
+        if(name == "ecb")
+            out = cipher_mode::ECB;
+        else if(name == "cbc")
+            out = cipher_mode::CBC;
+        else if(name == "cfb")
+            out = cipher_mode::CFB;
+        else if(name == "ofb")
+            out = cipher_mode::OFB;
+        else if(name == "ctr")
+            out = cipher_mode::CTR;
+        else
+            return false;
+
+        return true;
+    }
+
+    bool isChained(cipher_mode mode, bool encrypt)
+    {
+        switch(mode)
+        {
+            case cipher_mode::CBC:
+            case cipher_mode::CFB:
+                return encrypt;
+            case cipher_mode::OFB:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    uint64_t nextChain(cipher_mode mode, uint64_t lastInput, size_t count, uint64_t chain)
+    {
+        switch(mode)
+        {
+            case cipher_mode::CBC:
+            case cipher_mode::CFB:
+                return count ? lastInput : chain;
+            case cipher_mode::CTR:
+                return chain + count;
+            default:
+                return chain;
+        }
+    }
+
+    //! Encrypts an array of blocks with an implementation chosen at compile time
+    template<backend B>
+    static inline void encryptBulk(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        switch(B)
+        {
+            case backend::Reference: encryptBlocks(blocks, count, keys); break;
+            case backend::SPTable: encryptBlocksSP(blocks, count, keys); break;
+            default: encryptBlocksBS(blocks, count, keys); break;
+        }
+    }
+
+    //! Decrypts an array of blocks with an implementation chosen at compile time
+    template<backend B>
+    static inline void decryptBulk(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        switch(B)
+        {
+            case backend::Reference: decryptBlocks(blocks, count, keys); break;
+            case backend::SPTable: decryptBlocksSP(blocks, count, keys); break;
+            default: decryptBlocksBS(blocks, count, keys); break;
+        }
+    }
+
+    //! Encrypts a single block inline. A lone block can't fill a bitsliced batch, so bitslice uses the SP-tables like it does for leftovers
+    template<backend B, int Stages>
+    static inline uint64_t encryptOne(uint64_t block, const key_schedule& keys)
+    {
+        return B == backend::Reference ? process(block, keys.encryptKeys(), Stages) : processSP<Stages>(block, keys.encryptCooked());
+    }
+
+    //! processChunk with the implementation and number of stages fixed, so the chained modes inline the block cipher
+    template<backend B, int Stages>
+    static uint64_t processChunkWith(cipher_mode mode, bool encrypt, const key_schedule& keys,
+                                     uint64_t* blocks, size_t count, uint64_t chain, uint64_t* scratch)
+    {
+        if(!count)
+            return chain;
+
+        switch(mode)
+        {
+            case cipher_mode::ECB:
+                if(encrypt)
+                    encryptBulk<B>(blocks, count, keys);
+                else
+                    decryptBulk<B>(blocks, count, keys);
+                return chain;
+
+            case cipher_mode::CBC:
+                if(encrypt)
+                {
+                    for(size_t i=0; i<count; i++)
+                    {
+                        chain ^= blocks[i];
+                        chain = encryptOne<B, Stages>(chain, keys);
+                        blocks[i] = chain;
+                    }
+                    return chain;
+                }
+                else
+                {
+                    uint64_t next = blocks[count-1];
+                    for(size_t i=0; i<count; i++)
+                        scratch[i] = blocks[i];
+
+                    decryptBulk<B>(blocks, count, keys);
+
+                    blocks[0] ^= chain;
+                    for(size_t i=1; i<count; i++)
+                        blocks[i] ^= scratch[i-1];
+                    return next;
+                }
+
+            case cipher_mode::CFB:
+                if(encrypt)
+                {
+                    for(size_t i=0; i<count; i++)
+                    {
+                        chain = encryptOne<B, Stages>(chain, keys);
+                        chain ^= blocks[i];
+                        blocks[i] = chain;
+                    }
+                    return chain;
+                }
+                else
+                {
+                    scratch[0] = chain;
+                    for(size_t i=1; i<count; i++)
+                        scratch[i] = blocks[i-1];
+                    uint64_t next = blocks[count-1];
+
+                    encryptBulk<B>(scratch, count, keys);
+
+                    for(size_t i=0; i<count; i++)
+                        blocks[i] ^= scratch[i];
+                    return next;
+                }
+
+            case cipher_mode::OFB:
+                for(size_t i=0; i<count; i++)
+                {
+                    chain = encryptOne<B, Stages>(chain, keys);
+                    blocks[i] ^= chain;
+                }
+                return chain;
+
+            case cipher_mode::CTR:
+                for(size_t i=0; i<count; i++)
+                    scratch[i] = chain + i;
+
+                encryptBulk<B>(scratch, count, keys);
+
+                for(size_t i=0; i<count; i++)
+                    blocks[i] ^= scratch[i];
+                return chain + count;
+        }
+
+        return chain;
+    }
+
+    //! Picks the instance of processChunkWith for the number of stages in a schedule
+    template<backend B>
+    static uint64_t processChunkFor(cipher_mode mode, bool encrypt, const key_schedule& keys,
+                                    uint64_t* blocks, size_t count, uint64_t chain, uint64_t* scratch)
+    {
+        if(keys.stages() == 1)
+            return processChunkWith<B, 1>(mode, encrypt, keys, blocks, count, chain, scratch);
+        return processChunkWith<B, MAX_STAGES>(mode, encrypt, keys, blocks, count, chain, scratch);
+    }
+
+    uint64_t processChunk(cipher_mode mode, bool encrypt, backend impl, const key_schedule& keys,
+                          uint64_t* blocks, size_t count, uint64_t chain, uint64_t* scratch)
+    {
+        switch(impl)
+        {
+            case backend::Reference: return processChunkFor<backend::Reference>(mode, encrypt, keys, blocks, count, chain, scratch);
+            case backend::SPTable: return processChunkFor<backend::SPTable>(mode, encrypt, keys, blocks, count, chain, scratch);
+            default: return processChunkFor<backend::Bitslice>(mode, encrypt, keys, blocks, count, chain, scratch);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*! \file
+
+\brief Block cipher modes of operation for the 64-bit DES
+
+Each mode describes how blocks of the message are combined with the block cipher. \f$ E \f$ and \f$ D \f$
+are DES encryption and decryption, \f$ P_i \f$ and \f$ C_i \f$ are the plaintext and ciphertext blocks,
+and \f$ C_0 \f$ / \f$ O_0 \f$ is the initialization vector (IV)
+    - ECB : \f$ C_i = E(P_i) \f$
+    - CBC : \f$ C_i = E(P_i \oplus C_{i-1}) \f$, \f$ P_i = D(C_i) \oplus C_{i-1} \f$
+    - CFB : \f$ C_i = P_i \oplus E(C_{i-1}) \f$, \f$ P_i = C_i \oplus E(C_{i-1}) \f$
+    - OFB : \f$ O_i = E(O_{i-1}) \f$, \f$ C_i = P_i \oplus O_i \f$
+    - CTR : \f$ C_i = P_i \oplus E(IV + i - 1) \f$
+
+The modes differ in how much can be done in parallel
+    - ECB and CTR can process any block independently in both directions
+    - CBC and CFB decryption only need the previous ciphertext block, which is part of the input,
+      so a whole array can be decrypted (or encrypted, for CFB) in one call to the block cipher
+    - CBC and CFB encryption and OFB need the result of the previous block before starting
+      the next one, so they are processed one block at a time
+
+When a message is processed in chunks, each chunk needs a chaining value from the previous one;
+processChunk() returns the value to give the next chunk. For modes which are not chained, the
+value can also be found from the input alone with nextChain(), so chunks can be handed out to
+threads before the previous ones are processed.
+*/
+#ifndef DES64_MODES_H
+#define DES64_MODES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "des64_engine.h"
+
+namespace des64_engine
+{
+    //! Modes of operation
+    enum class cipher_mode{ECB, CBC, CFB, OFB, CTR};
+
+    /*! Looks up a mode by name
+
+        \param[in] name Name of the mode; one of ecb, cbc, cfb, ofb, ctr
+        \param[out] out The mode
+        \returns bool - Whether or not the name was valid
+    */
+    bool modeFromName(const std::string& name, cipher_mode& out);
+
+    /*! Checks whether each block depends on the result of processing the block before it
+
+        \param[in] mode The mode
+        \param[in] encrypt Whether encrypting or decrypting
+        \returns bool - Whether chunks must be processed in order, one at a time
+    */
+    bool isChained(cipher_mode mode, bool encrypt);
+
+    /*! Finds the chaining value for the chunk after this one without processing it. Only valid if !isChained()
+
+        \param[in] mode The mode
+        \param[in] lastInput The last input block of this chunk
+        \param[in] count Number of blocks in this chunk
+        \param[in] chain The chaining value for this chunk
+        \returns uint64_t - The chaining value for the next chunk
+    */
+    uint64_t nextChain(cipher_mode mode, uint64_t lastInput, size_t count, uint64_t chain);
+
+    /*! Encrypts or decrypts a chunk of blocks in place
+
+        \param[in] mode The mode
+        \param[in] encrypt Whether to encrypt or decrypt
+        \param[in] impl The DES implementation to use
+        \param[in] keys The key schedule to use
+        \param[in,out] blocks The blocks to process
+        \param[in] count Number of blocks
+        \param[in] chain The chaining value; the IV for the first chunk, otherwise the value returned for the chunk before
+        \param[out] scratch Space for count blocks
+        \returns uint64_t - The chaining value for the next chunk
+    */
+    uint64_t processChunk(cipher_mode mode, bool encrypt, backend impl, const key_schedule& keys,
+                          uint64_t* blocks, size_t count, uint64_t chain, uint64_t* scratch);
+}
+
+#endif
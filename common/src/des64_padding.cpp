@@ -0,0 +1,146 @@
+#include "des64_padding.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace des64_engine
+{
+    //! Reads 8 bytes as a big-endian block
+    static uint64_t loadBlock(const unsigned char* bytes)
+    {
+        uint64_t block = 0;
+        for(int i=0; i<8; i++)
+            block = (block << 8) | bytes[i];
+        return block;
+    }
+
+    //! Writes a block as 8 big-endian bytes
+    static void storeBlock(uint64_t block, unsigned char* bytes)
+    {
+        for(int i=7; i>=0; i--, block >>= 8)
+            bytes[i] = block & 0xFF;
+    }
+
+    //! Runs one block through a mode, starting from a chaining value
+    static uint64_t processOne(cipher_mode mode, bool encrypt, backend impl, const key_schedule& keys, uint64_t block, uint64_t chain)
+    {
+        uint64_t scratch;
+        processChunk(mode, encrypt, impl, keys, &block, 1, chain, &scratch);
+        return block;
+    }
+
+    bool paddingFromName(const std::string& name, padding& out)
+    {
+        if(name == "none")
+            out = padding::None;
+        else if(name == "pkcs7")
+            out = padding::PKCS7;
+        else if(name == "cts")
+            out = padding::CTS;
+        else
+            return false;
+
+        return true;
+    }
+
+    size_t heldBlocks(padding pad, cipher_mode mode, bool encrypt)
+    {
+        if(pad == padding::PKCS7)
+            return encrypt ? 0 : 1;
+        if(pad == padding::CTS)
+            return (mode == cipher_mode::ECB || mode == cipher_mode::CBC) ? 1 : 0;
+        return 0;
+    }
+
+    bool outputSize(padding pad, bool encrypt, uint64_t size, uint64_t& out)
+    {
+        switch(pad)
+        {
+            case padding::PKCS7:
+                out = size - size % 8 + 8;
+                return encrypt;
+            case padding::CTS:
+                out = size;
+                return true;
+            default:
+                out = size - size % 8;
+                return true;
+        }
+    }
+
+    size_t processTail(padding pad, cipher_mode mode, bool encrypt, backend impl, const key_schedule& keys,
+                       const unsigned char* tail, size_t size, uint64_t chain, unsigned char* out)
+    {
+        if(pad == padding::None)
+            return 0;
+
+        if(pad == padding::PKCS7)
+        {
+            if(encrypt)
+            {
+                unsigned char last[8];
+                std::copy(tail, tail + size, last);
+                std::fill(last + size, last + 8, 8 - size);
+                storeBlock(processOne(mode, true, impl, keys, loadBlock(last), chain), out);
+                return 8;
+            }
+
+            if(size != 8)
+                throw std::runtime_error("PKCS#7 padded input must be a non-zero multiple of 8 bytes");
+
+            storeBlock(processOne(mode, false, impl, keys, loadBlock(tail), chain), out);
+            size_t n = out[7];
+            if(n < 1 || n > 8 || std::count(out + 8 - n, out + 8, n) != (long)n)
+                throw std::runtime_error("Invalid PKCS#7 padding");
+            return 8 - n;
+        }
+
+        //The partial block of a stream mode only needs the start of the next block of key stream
+        if(mode != cipher_mode::ECB && mode != cipher_mode::CBC)
+        {
+            unsigned char stream[8];
+            storeBlock(processOne(cipher_mode::ECB, true, impl, keys, chain, 0), stream);
+            for(size_t i=0; i<size; i++)
+                out[i] = tail[i] ^ stream[i];
+            return size;
+        }
+
+        if(size < 8)
+            throw std::runtime_error("Ciphertext stealing needs at least one full block");
+
+        if(size == 8)
+        {
+            storeBlock(processOne(mode, encrypt, impl, keys, loadBlock(tail), chain), out);
+            return 8;
+        }
+
+        size_t d = size - 8;
+        if(encrypt)
+        {
+            //The last full block, then the partial block filled out with 0's
+            unsigned char buffer[16] = {0};
+            std::copy(tail, tail + size, buffer);
+
+            uint64_t stolen = processOne(mode, true, impl, keys, loadBlock(buffer), chain);
+            storeBlock(stolen, buffer);
+            if(mode == cipher_mode::ECB)
+                std::copy(buffer + d, buffer + 8, buffer + 8 + d);
+            storeBlock(processOne(mode, true, impl, keys, loadBlock(buffer + 8), stolen), buffer + 8);
+
+            std::copy(buffer, buffer + d, out);
+            std::copy(buffer + 8, buffer + 16, out + d);
+            return size;
+        }
+
+        //The last block decrypts to the partial block followed by the bytes stolen from the one before it
+        unsigned char last[8], previous[8];
+        storeBlock(processOne(cipher_mode::ECB, false, impl, keys, loadBlock(tail + d), 0), last);
+        std::copy(tail, tail + d, previous);
+        std::copy(last + d, last + 8, previous + d);
+
+        storeBlock(processOne(mode, false, impl, keys, loadBlock(previous), chain), out);
+        for(size_t i=0; i<d; i++)
+            out[8 + i] = last[i] ^ (mode == cipher_mode::CBC ? tail[i] : 0);
+        return size;
+    }
+}
@@ -0,0 +1,85 @@
+/*! \file
+
+\brief Handling of the last, partial block of a message for the 64-bit DES
+
+The block cipher only processes whole 8-byte blocks. A message whose length is not a multiple of 8 needs
+one of these schemes for its last few bytes
+    - none : The bytes after the last full block are dropped
+    - pkcs7 : Encryption appends \f$ n \f$ bytes of value \f$ n \f$ (1 to 8) so the length becomes a multiple of 8;
+      decryption checks and removes them. The output of encryption is 1 to 8 bytes longer than the input
+    - cts : Ciphertext stealing; the output is exactly as long as the input. For ECB and CBC, the partial block
+      \f$ P_n^* \f$ of \f$ d \f$ bytes is filled out with the end of the ciphertext of the block before it, and
+      that ciphertext is cut down to \f$ d \f$ bytes and written before the last full block (the CBC-CS1
+      ordering, so a message which is a multiple of 8 bytes encrypts exactly as it would without padding).
+      The message must be at least 8 bytes long. For CFB, OFB, and CTR, the partial block is combined with the
+      first \f$ d \f$ bytes of the next block of key stream
+
+Only the end of the message is affected, so the tools process everything up to it with the usual chunks and
+hand the last few bytes to processTail() once the input runs out. Schemes which need to see the last full block
+as well (decrypting pkcs7, and cts for ECB and CBC) have one full block held back from the chunks; heldBlocks()
+says how many. Since the tail is never more than two blocks, it is the only part of the message which is buffered
+separately.
+*/
+#ifndef DES64_PADDING_H
+#define DES64_PADDING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "des64_modes.h"
+
+namespace des64_engine
+{
+    //! Schemes for the last block
+    enum class padding{None, PKCS7, CTS};
+
+    //! Largest number of bytes processTail() can be given or write
+    constexpr size_t MAX_TAIL = 16;
+
+    /*! Looks up a padding scheme by name
+
+        \param[in] name Name of the scheme; one of none, pkcs7, cts
+        \param[out] out The scheme
+        \returns bool - Whether or not the name was valid
+    */
+    bool paddingFromName(const std::string& name, padding& out);
+
+    /*! Gets the number of full blocks which have to be left for processTail() along with any partial block
+
+        \param[in] pad The padding scheme
+        \param[in] mode The mode
+        \param[in] encrypt Whether encrypting or decrypting
+        \returns size_t - 0 or 1
+    */
+    size_t heldBlocks(padding pad, cipher_mode mode, bool encrypt);
+
+    /*! Finds the size of the output for an input size, if it can be known before processing
+
+        \param[in] pad The padding scheme
+        \param[in] encrypt Whether encrypting or decrypting
+        \param[in] size Size of the input in bytes
+        \param[out] out Size of the output in bytes
+        \returns bool - Whether the size is known; it isn't when decrypting pkcs7, since it depends on the last block
+    */
+    bool outputSize(padding pad, bool encrypt, uint64_t size, uint64_t& out);
+
+    /*! Processes the end of a message
+
+        \param[in] pad The padding scheme
+        \param[in] mode The mode
+        \param[in] encrypt Whether encrypting or decrypting
+        \param[in] impl The DES implementation to use
+        \param[in] keys The key schedule to use
+        \param[in] tail The bytes after the last block which was processed; up to heldBlocks() blocks and a partial block
+        \param[in] size Number of bytes in tail
+        \param[in] chain The chaining value left by the last block which was processed, or the IV if there was none
+        \param[out] out Where to write the processed bytes; must have room for MAX_TAIL bytes
+        \returns size_t - Number of bytes written to out
+        \throws runtime_error - If pkcs7 padding is invalid, or the message is too short for the scheme
+    */
+    size_t processTail(padding pad, cipher_mode mode, bool encrypt, backend impl, const key_schedule& keys,
+                       const unsigned char* tail, size_t size, uint64_t chain, unsigned char* out);
+}
+
+#endif
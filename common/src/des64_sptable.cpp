@@ -0,0 +1,54 @@
+#include "des64_sptable.h"
+#include "des64_tables.h"
+
+namespace des64_engine
+{
+    namespace sptable
+    {
+        //! Permutes each S-box output into its final position
+        static constexpr sp_tables spTables()
+        {
+            sp_tables out{};
+            for(int box=0; box<8; box++)
+            {
+                for(int six=0; six<64; six++)
+                {
+                    //Outer bits pick the row, inner bits pick the column
+                    int row = ((six >> 4) & 0x2) | (six & 0x1);
+                    int col = (six >> 1) & 0xF;
+
+                    uint32_t s = (uint32_t)tables::S[box][row*16 + col] << (28 - 4*box);
+                    out.sp[box][six] = rotl(permute(s, tables::P, 32, 32), 1);
+                }
+            }
+            return out;
+        }
+
+        //Declared extern in the header, so this constant expression has external linkage
+        constexpr sp_tables SP = spTables();
+    }
+
+    //! Processes an array of blocks with the stage count fixed at compile time
+    template<int Stages>
+    static void processBlocksSP(uint64_t* blocks, size_t count, const cooked_keys& keys)
+    {
+        for(size_t i=0; i<count; i++)
+            blocks[i] = processSP<Stages>(blocks[i], keys);
+    }
+
+    void encryptBlocksSP(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        if(keys.stages() == 1)
+            processBlocksSP<1>(blocks, count, keys.encryptCooked());
+        else
+            processBlocksSP<MAX_STAGES>(blocks, count, keys.encryptCooked());
+    }
+
+    void decryptBlocksSP(uint64_t* blocks, size_t count, const key_schedule& keys)
+    {
+        if(keys.stages() == 1)
+            processBlocksSP<1>(blocks, count, keys.decryptCooked());
+        else
+            processBlocksSP<MAX_STAGES>(blocks, count, keys.decryptCooked());
+    }
+}
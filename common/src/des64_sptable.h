@@ -0,0 +1,151 @@
+/*! \file
+
+\brief SP-table implementation of the 64-bit DES
+
+The reference rounds (des64_keyschedule.h) expand the right half bit-by-bit, look up the
+8 S-boxes, and then permute the 32-bit result with P bit-by-bit. Because P only moves bits,
+each S-box output can be permuted on its own; so every S-box can be fused with P into a table of
+64 32-bit values which already have the S-box output bits in their final positions. The round
+function then becomes 8 table lookups OR'd together.
+
+The expansion is avoided by keeping both halves of the block rotated left by 1 bit; in that
+form the 6 bits going into S-boxes 2, 4, 6, 8 are one byte apart, and the 6 bits going into
+S-boxes 1, 3, 5, 7 are one byte apart after rotating right by 4. The round keys are pre-split
+into matching words (see key_schedule::encryptCooked()) and the table values are stored rotated
+by 1 as well.
+
+The initial and final permutations are done with a sequence of swap-move operations, each of
+which exchanges a group of bits between the two halves with a shift, xor, and mask. For triple DES,
+they are only done once; between stages the halves are just swapped.
+*/
+#ifndef DES64_SPTABLE_H
+#define DES64_SPTABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include "des64_keyschedule.h"
+
+namespace des64_engine
+{
+    //! Pieces of the SP-table rounds, kept in the header so the rounds can be inlined into their callers
+    namespace sptable
+    {
+        //! Rotates a 32-bit value left
+        constexpr uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+        //! Rotates a 32-bit value right
+        constexpr uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+        //! Exchanges the bits of b selected by mask with the bits of a selected by mask << shift
+        inline void swapMove(uint32_t& a, uint32_t& b, int shift, uint32_t mask)
+        {
+            uint32_t t = ((a >> shift) ^ b) & mask;
+            b ^= t;
+            a ^= t << shift;
+        }
+
+        //! The fused S-box and P tables, rotated left by 1; aligned so each box fills exactly 4 cache lines
+        struct alignas(64) sp_tables
+        {
+            uint32_t sp[8][64];
+        };
+
+        //! The tables, generated at compile time from the S-boxes and P
+        extern const sp_tables SP;
+    }
+
+    /*! Runs each stage of the DES on a block using the SP-tables
+
+        The number of stages is a template parameter so the loop over the rounds has a fixed length,
+        which lets the compiler unroll it and inline the whole block into callers which process one
+        block at a time.
+
+        \tparam Stages Number of 16-round stages in keys; 1 or 3
+        \param[in] block The block to process
+        \param[in] keys The round keys in SP-table form, in the order they should be used
+        \returns uint64_t - The processed block
+    */
+    template<int Stages>
+    inline uint64_t processSP(uint64_t block, const cooked_keys& keys)
+    {
+        using namespace sptable;
+
+        uint32_t left = block >> 32;
+        uint32_t right = block & 0xFFFFFFFF;
+
+        //Initial permutation; leaves both halves rotated left by 1
+        swapMove(left, right, 4, 0x0F0F0F0F);
+        swapMove(left, right, 16, 0x0000FFFF);
+        swapMove(right, left, 2, 0x33333333);
+        swapMove(right, left, 8, 0x00FF00FF);
+        right = rotl(right, 1);
+        uint32_t t = (left ^ right) & 0xAAAAAAAA;
+        left ^= t;
+        right ^= t;
+        left = rotl(left, 1);
+
+        //Two rounds at a time so the halves never need to be swapped within a stage
+        const uint32_t* k = keys.data();
+        for(int i=0; i<Stages*ROUNDS; i+=2, k+=4)
+        {
+            //The next stage's IP would undo this stage's FP, leaving only the swap
+            if(i && i % ROUNDS == 0)
+                std::swap(left, right);
+
+            uint32_t w = rotr(right, 4) ^ k[0];
+            uint32_t v = right ^ k[1];
+            left ^= SP.sp[6][w & 0x3F] | SP.sp[4][(w >> 8) & 0x3F] | SP.sp[2][(w >> 16) & 0x3F] | SP.sp[0][(w >> 24) & 0x3F] |
+                    SP.sp[7][v & 0x3F] | SP.sp[5][(v >> 8) & 0x3F] | SP.sp[3][(v >> 16) & 0x3F] | SP.sp[1][(v >> 24) & 0x3F];
+
+            w = rotr(left, 4) ^ k[2];
+            v = left ^ k[3];
+            right ^= SP.sp[6][w & 0x3F] | SP.sp[4][(w >> 8) & 0x3F] | SP.sp[2][(w >> 16) & 0x3F] | SP.sp[0][(w >> 24) & 0x3F] |
+                     SP.sp[7][v & 0x3F] | SP.sp[5][(v >> 8) & 0x3F] | SP.sp[3][(v >> 16) & 0x3F] | SP.sp[1][(v >> 24) & 0x3F];
+        }
+
+        //Final permutation on the swapped halves; undoes the rotation
+        right = rotr(right, 1);
+        t = (left ^ right) & 0xAAAAAAAA;
+        left ^= t;
+        right ^= t;
+        left = rotr(left, 1);
+        swapMove(left, right, 8, 0x00FF00FF);
+        swapMove(left, right, 2, 0x33333333);
+        swapMove(right, left, 16, 0x0000FFFF);
+        swapMove(right, left, 4, 0x0F0F0F0F);
+
+        return ((uint64_t)right << 32) | left;
+    }
+
+    /*! Runs each stage of the DES on a block using the SP-tables
+
+        \param[in] block The block to process
+        \param[in] keys The round keys in SP-table form, in the order they should be used
+        \param[in] stages Number of 16-round stages in keys
+        \returns uint64_t - The processed block
+    */
+    inline uint64_t processSP(uint64_t block, const cooked_keys& keys, int stages)
+    {
+        return stages == 1 ? processSP<1>(block, keys) : processSP<MAX_STAGES>(block, keys);
+    }
+
+    /*! Encrypts an array of blocks in place using the SP-tables
+
+        \param[in,out] blocks The blocks to encrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to encrypt with
+    */
+    void encryptBlocksSP(uint64_t* blocks, size_t count, const key_schedule& keys);
+
+    /*! Decrypts an array of blocks in place using the SP-tables
+
+        \param[in,out] blocks The blocks to decrypt
+        \param[in] count Number of blocks
+        \param[in] keys The key schedule to decrypt with
+    */
+    void decryptBlocksSP(uint64_t* blocks, size_t count, const key_schedule& keys);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include "des64_tables.h"
+
+namespace des64_engine
+{
+    namespace tables
+    {
+        //! Follows each round key bit back through the rotations and PC-1 to the key bit it started as
+        static constexpr key_bits roundKeyBits()
+        {
+            key_bits out{};
+            int shift = 0;
+            for(int r=0; r<16; r++)
+            {
+                shift += SHIFTS[r];
+                for(int i=0; i<48; i++)
+                {
+                    //C and D rotate separately, so the bit stays within its own half
+                    int k = PC2[i] - 1;
+                    int source = (k < 28 ? (k + shift) % 28 : 28 + (k - 28 + shift) % 28);
+                    out.bits[r][i] = PC1[source];
+                }
+            }
+            return out;
+        }
+
+        //! Checks that FP undoes IP
+        static constexpr bool inverse(const int* forward, const int* backward, int bits)
+        {
+            for(int i=0; i<bits; i++)
+                if(backward[forward[i] - 1] != i + 1)
+                    return false;
+            return true;
+        }
+
+        static_assert(inverse(IP, FP, 64), "FP must be the inverse of IP");
+
+        //Declared extern in the header, so this constant expression has external linkage
+        constexpr key_bits ROUND_KEY_BITS = roundKeyBits();
+    }
+}
@@ -0,0 +1,188 @@
+#include "hex_codec.h"
+
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace hex_codec
+{
+    //! Character for each nibble
+    static const char DIGITS[] = "0123456789abcdef";
+
+    /*! Converts a hexadecimal character to its value
+
+        \param[in] c The character
+        \returns int - The value, or -1 if c is not hexadecimal
+    */
+    static inline int nibble(char c)
+    {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+#if defined(__AVX2__)
+    //! Turns 32 nibbles into their characters
+    static inline __m256i encodeNibbles(__m256i n)
+    {
+        __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(n, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10));
+        return _mm256_add_epi8(_mm256_add_epi8(n, _mm256_set1_epi8('0')), letters);
+    }
+
+    /*! Turns 32 characters into their nibbles
+
+        \param[in] c The characters
+        \param[out] valid Set of characters which were hexadecimal
+        \returns __m256i - The nibbles
+    */
+    static inline __m256i decodeNibbles(__m256i c, __m256i& valid)
+    {
+        __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+
+        valid = _mm256_or_si256(digit, alpha);
+        return _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+                               _mm256_and_si256(alpha, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+    }
+#elif defined(__SSE2__)
+    //! Turns 16 nibbles into their characters
+    static inline __m128i encodeNibbles(__m128i n)
+    {
+        __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+        return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+    }
+
+    /*! Turns 16 characters into their nibbles
+
+        \param[in] c The characters
+        \param[out] valid Set of characters which were hexadecimal
+        \returns __m128i - The nibbles
+    */
+    static inline __m128i decodeNibbles(__m128i c, __m128i& valid)
+    {
+        __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+        valid = _mm_or_si128(digit, alpha);
+        return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                            _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    }
+#endif
+
+    void encode(const unsigned char* in, size_t size, char* out)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        const __m256i low = _mm256_set1_epi8(0x0F);
+        for(; i + 32 <= size; i += 32, out += 64)
+        {
+            __m256i bytes = _mm256_loadu_si256((const __m256i*)(in + i));
+            __m256i hi = encodeNibbles(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), low));
+            __m256i lo = encodeNibbles(_mm256_and_si256(bytes, low));
+
+            //Unpacking interleaves within each 128-bit lane, so the lanes are put back in order after
+            __m256i first = _mm256_unpacklo_epi8(hi, lo);
+            __m256i second = _mm256_unpackhi_epi8(hi, lo);
+            _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(first, second, 0x20));
+            _mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+        }
+#elif defined(__SSE2__)
+        const __m128i low = _mm_set1_epi8(0x0F);
+        for(; i + 16 <= size; i += 16, out += 32)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i hi = encodeNibbles(_mm_and_si128(_mm_srli_epi16(bytes, 4), low));
+            __m128i lo = encodeNibbles(_mm_and_si128(bytes, low));
+
+            _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+            _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+        }
+#endif
+
+        for(; i < size; i++)
+        {
+            *out++ = DIGITS[in[i] >> 4];
+            *out++ = DIGITS[in[i] & 0xF];
+        }
+    }
+
+    bool decode(const char* in, size_t size, unsigned char* out)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for(; i + 64 <= size; i += 64, out += 32)
+        {
+            __m256i valid1, valid2;
+            __m256i n1 = decodeNibbles(_mm256_loadu_si256((const __m256i*)(in + i)), valid1);
+            __m256i n2 = decodeNibbles(_mm256_loadu_si256((const __m256i*)(in + i + 32)), valid2);
+            if(~_mm256_movemask_epi8(_mm256_and_si256(valid1, valid2)))
+                return false;
+
+            //Each 16-bit word holds the high nibble in its low byte and the low nibble in its high byte
+            const __m256i high = _mm256_set1_epi16(0x00F0);
+            __m256i b1 = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(n1, 4), high), _mm256_srli_epi16(n1, 8));
+            __m256i b2 = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(n2, 4), high), _mm256_srli_epi16(n2, 8));
+
+            //Packing works within each 128-bit lane, so the quarters are put back in order after
+            _mm256_storeu_si256((__m256i*)out, _mm256_permute4x64_epi64(_mm256_packus_epi16(b1, b2), 0xD8));
+        }
+#elif defined(__SSE2__)
+        for(; i + 32 <= size; i += 32, out += 16)
+        {
+            __m128i valid1, valid2;
+            __m128i n1 = decodeNibbles(_mm_loadu_si128((const __m128i*)(in + i)), valid1);
+            __m128i n2 = decodeNibbles(_mm_loadu_si128((const __m128i*)(in + i + 16)), valid2);
+            if(_mm_movemask_epi8(_mm_and_si128(valid1, valid2)) != 0xFFFF)
+                return false;
+
+            //Each 16-bit word holds the high nibble in its low byte and the low nibble in its high byte
+            const __m128i high = _mm_set1_epi16(0x00F0);
+            __m128i b1 = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(n1, 4), high), _mm_srli_epi16(n1, 8));
+            __m128i b2 = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(n2, 4), high), _mm_srli_epi16(n2, 8));
+
+            _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(b1, b2));
+        }
+#endif
+
+        for(; i + 1 < size; i += 2)
+        {
+            int hi = nibble(in[i]), lo = nibble(in[i+1]);
+            if(hi < 0 || lo < 0)
+                return false;
+
+            *out++ = (hi << 4) | lo;
+        }
+
+        return true;
+    }
+
+    string charsFromHex(const string& input)
+    {
+        string padded = input;
+        if(padded.size() % 2 == 1) padded.push_back('0');
+
+        string out(padded.size() / 2, '\0');
+        if(!decode(padded.data(), padded.size(), (unsigned char*)&out[0]))
+            throw logic_error("");
+
+        return out;
+    }
+
+    string hexFromChars(const string& input)
+    {
+        string out(input.size() * 2, '\0');
+        encode((const unsigned char*)input.data(), input.size(), &out[0]);
+        return out;
+    }
+}
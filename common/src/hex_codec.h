@@ -0,0 +1,56 @@
+/*! \file
+
+\brief Hexadecimal encoding and decoding of whole buffers
+
+Each byte is written as two lowercase hexadecimal characters, high nibble first. Decoding accepts
+both upper and lower case.
+
+When compiled with SSE2 or AVX2 enabled, 16 or 32 bytes are converted at a time. Encoding splits the
+bytes into their nibbles, turns each nibble into a character with a compare and an add, and interleaves
+the high and low nibbles. Decoding range checks every character against [0-9], [a-f] and [A-F] at once,
+converts them to nibbles, and packs pairs of nibbles back into bytes. Anything left over, or everything
+on other platforms, goes through a lookup table.
+*/
+#ifndef HEX_CODEC_H
+#define HEX_CODEC_H
+
+#include <cstddef>
+#include <string>
+
+namespace hex_codec
+{
+    /*! Encodes bytes as hexadecimal characters
+
+        \param[in] in Bytes to encode
+        \param[in] size Number of bytes
+        \param[out] out Where to write the characters; must have room for 2*size characters
+    */
+    void encode(const unsigned char* in, size_t size, char* out);
+
+    /*! Decodes hexadecimal characters into bytes
+
+        \param[in] in Characters to decode
+        \param[in] size Number of characters; must be even
+        \param[out] out Where to write the bytes; must have room for size/2 bytes
+        \returns bool - Whether every character was hexadecimal. If not, out is partially written
+    */
+    bool decode(const char* in, size_t size, unsigned char* out);
+
+    /*! Converts hexadecimal values to a string of characters. Each character is made from two hex values.
+        If there are an odd number of values, a 0 is appended.
+
+        \param[in] input Characters to convert
+        \returns string - The ASCII output
+        \throws logic_error - If the input is not hexadecimal
+    */
+    std::string charsFromHex(const std::string& input);
+
+    /*! Converts characters to hexadecimal values. Each character becomes two values
+
+        \param[in] input Characters to convert
+        \returns string - The hexadecimal output
+    */
+    std::string hexFromChars(const std::string& input);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool sameFile(const std::string& first, const std::string& second)
+{
+    struct stat a, b;
+    if(stat(first.c_str(), &a) || stat(second.c_str(), &b))
+        return false;
+
+    return S_ISREG(a.st_mode) && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+void discardOutput(const std::string& path)
+{
+    struct stat info;
+    if(!stat(path.c_str(), &info) && S_ISREG(info.st_mode))
+        unlink(path.c_str());
+}
+
+mapped_file::mapped_file() : _fd(-1), _data(nullptr), _size(0)
+{
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+bool mapped_file::openRead(const std::string& path)
+{
+    close();
+
+    struct stat info;
+    if(stat(path.c_str(), &info) || !S_ISREG(info.st_mode) || info.st_size == 0)
+        return false;
+
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if(_fd < 0)
+        return false;
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+    if(data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    _data = (unsigned char*)data;
+    _size = info.st_size;
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+bool mapped_file::openWrite(const std::string& path, size_t size)
+{
+    close();
+
+    //Don't open pipes or devices; opening a pipe could block until it has a reader
+    struct stat info;
+    if(!stat(path.c_str(), &info) && !S_ISREG(info.st_mode))
+        return false;
+
+    if(size == 0)
+        return false;
+
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(_fd < 0)
+        return false;
+
+    //posix_fallocate returns an error number rather than setting errno
+    if(posix_fallocate(_fd, 0, size))
+    {
+        close();
+        return false;
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if(data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    _data = (unsigned char*)data;
+    _size = size;
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+void mapped_file::close()
+{
+    if(_data)
+        munmap(_data, _size);
+
+    if(_fd >= 0)
+        ::close(_fd);
+
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+}
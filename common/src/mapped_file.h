@@ -0,0 +1,96 @@
+/*! \file
+
+\brief Memory mapped files
+
+When the tools read or write regular files, the files are mapped into memory so that data can be
+transformed directly from the input's pages to the output's pages in the page cache, without being copied
+through stream buffers. Input files are advised as sequential so the kernel reads ahead aggressively.
+Output files are created at their final size with posix_fallocate before being mapped, so that every chunk
+of output has a place to go as soon as it is processed, regardless of the order chunks finish in. The space is
+reserved on disk up front: a sparse file would only find out that the disk is full when a store into the mapping
+raised SIGBUS, so if the space can't be reserved, opening fails and the tools write a stream instead.
+
+Files which are not regular files (pipes, terminals, devices) or which are empty can't be mapped; in that
+case opening fails and the tools fall back to streams.
+
+Opening the output truncates it, so the tools check with sameFile() that the output isn't the input before
+opening it; otherwise the input would be destroyed before it is read, whether it is mapped or read as a stream.
+If processing fails once the output has been opened, the tools remove it with discardOutput() rather than leave
+a partly written or zero-filled file behind.
+*/
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*! Checks whether two paths name the same regular file, through links or different spellings of the path
+
+    \param[in] first The first path
+    \param[in] second The second path
+    \returns bool - Whether both exist and have the same device and inode
+*/
+bool sameFile(const std::string& first, const std::string& second);
+
+/*! Removes an output file which failed part way through. Pipes and devices, such as /dev/null, are left alone
+
+    The file should be closed, or its mapping closed, first.
+
+    \param[in] path The output file
+*/
+void discardOutput(const std::string& path);
+
+//! A file mapped into memory for reading or writing
+class mapped_file
+{
+public:
+    mapped_file();
+
+    //! Unmaps and closes the file, if open
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    /*! Maps an existing file for reading
+
+        \param[in] path The file to map
+        \returns bool - Whether the file was mapped. False if it isn't a regular file, is empty, or can't be mapped
+    */
+    bool openRead(const std::string& path);
+
+    /*! Creates or truncates a file, reserves its space, and maps it for writing
+
+        If the file exists and is not a regular file, it is not touched.
+        If the space can't be reserved, for example because the disk is full, the file is not mapped.
+
+        \param[in] path The file to map
+        \param[in] size Size to make the file
+        \returns bool - Whether the file was mapped
+    */
+    bool openWrite(const std::string& path, size_t size);
+
+    //! Unmaps and closes the file
+    void close();
+
+    //! \returns bool - Whether a file is currently mapped
+    bool isOpen() const { return _data != nullptr; }
+
+    //! \returns unsigned char* - The mapped data
+    unsigned char* data() const { return _data; }
+
+    //! \returns size_t - The size of the mapped data
+    size_t size() const { return _size; }
+
+private:
+    //! File descriptor of the mapped file
+    int _fd;
+
+    //! Start of the mapping
+    unsigned char* _data;
+
+    //! Size of the mapping
+    size_t _size;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "parallel.h"
+
+namespace parallel
+{
+    unsigned hardwareThreads()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    worker_pool::worker_pool(unsigned threads) : _stopping(false)
+    {
+        for(unsigned i=0; i<threads; i++)
+            _threads.emplace_back(&worker_pool::run, this);
+    }
+
+    worker_pool::~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _stopping = true;
+        }
+        _ready.notify_all();
+
+        for(std::thread& t : _threads)
+            t.join();
+    }
+
+    void worker_pool::submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _jobs.push_back(std::move(job));
+        }
+        _ready.notify_one();
+    }
+
+    void worker_pool::run()
+    {
+        while(true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _ready.wait(guard, [this](){ return _stopping || _jobs.size(); });
+                if(_jobs.empty())
+                    return;
+
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            job();
+        }
+    }
+}
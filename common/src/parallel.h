@@ -0,0 +1,176 @@
+/*! \file
+
+\brief Ordered parallel processing of a stream of chunks
+
+The tools process their input as a sequence of independent chunks. To use multiple cores, chunks are
+read on the calling thread and handed to a fixed pool of worker threads, with up to one chunk in flight
+per worker. The workers are started once for the whole run and take chunks from a queue, so no thread is
+created for each chunk. Finished chunks are written back on the calling thread in the same order they were read,
+so the output is identical to processing the chunks one at a time. While chunks are being processed,
+the calling thread continues reading the next ones, so I/O overlaps with the processing.
+
+Some work can't be split up because each chunk depends on the result of the one before it. In chained
+mode, each chunk's work waits for the previous chunk's work to finish, so chunks are processed one at a
+time in order; reading and writing still overlap with the processing.
+
+Chunk objects are reused once they are written, so there are never more than threads + 1 of them.
+*/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! Helpers for running the tools on multiple threads
+namespace parallel
+{
+    /*! Gets the number of threads to use when the user asks for as many as possible
+
+        \returns unsigned - The number of hardware threads, or 1 if unknown
+    */
+    unsigned hardwareThreads();
+
+    //! A fixed set of threads which run jobs from a queue, in the order they were submitted
+    class worker_pool
+    {
+    public:
+        /*! Starts the threads
+
+            \param[in] threads Number of threads
+        */
+        explicit worker_pool(unsigned threads);
+
+        //! Runs every job which has already been submitted, then stops the threads
+        ~worker_pool();
+
+        worker_pool(const worker_pool&) = delete;
+        worker_pool& operator=(const worker_pool&) = delete;
+
+        /*! Queues a job for the next free thread
+
+            \param[in] job The job
+        */
+        void submit(std::function<void()> job);
+
+    private:
+        //! Takes jobs from the queue until the pool stops
+        void run();
+
+        //! The worker threads
+        std::vector<std::thread> _threads;
+
+        //! Jobs not yet started
+        std::deque<std::function<void()>> _jobs;
+
+        //! Guards _jobs and _stopping
+        std::mutex _lock;
+
+        //! Signalled when a job is queued or the pool stops
+        std::condition_variable _ready;
+
+        //! Whether the threads should exit once the queue is empty
+        bool _stopping;
+    };
+
+    /*! Processes a sequence of chunks on multiple threads, writing them in order
+
+        If an exception is thrown while processing a chunk, it is rethrown when that chunk
+        would have been written, after the chunks before it have been written.
+
+        When chained, each call to work happens after the previous one has returned, so work may
+        use state left by the call before it without any other synchronization.
+
+        \param[in] threads Number of worker threads, and the maximum number of chunks to process at once. If 1, everything runs on the calling thread
+        \param[in] read Called as bool(Chunk&) on the calling thread to fill the next chunk; returns false when there are no more
+        \param[in] work Called as void(Chunk&) on a worker thread to process a chunk
+        \param[in] write Called as void(Chunk&) on the calling thread with each processed chunk, in the order they were read
+        \param[in] chained Whether each chunk must be processed after the one before it
+    */
+    template<class Chunk, class Reader, class Worker, class Writer>
+    void ordered(unsigned threads, Reader read, Worker work, Writer write, bool chained = false)
+    {
+        if(threads <= 1)
+        {
+            Chunk chunk;
+            while(read(chunk))
+            {
+                work(chunk);
+                write(chunk);
+            }
+            return;
+        }
+
+        std::deque<std::pair<std::unique_ptr<Chunk>, std::shared_future<void>>> inFlight;
+        std::vector<std::unique_ptr<Chunk>> spare;
+
+        //Destroyed before the chunks, once every job has finished
+        worker_pool pool(threads);
+
+        //Waits for the oldest chunk, writes it, and keeps it to reuse
+        auto retire = [&]()
+        {
+            std::unique_ptr<Chunk> chunk = std::move(inFlight.front().first);
+            std::shared_future<void> done = std::move(inFlight.front().second);
+            inFlight.pop_front();
+
+            done.get();
+            write(*chunk);
+            spare.push_back(std::move(chunk));
+        };
+
+        try
+        {
+            while(true)
+            {
+                std::unique_ptr<Chunk> chunk;
+                if(spare.empty())
+                {
+                    chunk.reset(new Chunk());
+                }
+                else
+                {
+                    chunk = std::move(spare.back());
+                    spare.pop_back();
+                }
+
+                if(!read(*chunk)) break;
+
+                Chunk* raw = chunk.get();
+                std::shared_future<void> previous;
+                if(chained && inFlight.size())
+                    previous = inFlight.back().second;
+
+                //Jobs start in the order they are queued, so a chained job only ever waits on one that is already running
+                auto task = std::make_shared<std::packaged_task<void()>>(
+                    [&work, raw, previous]()
+                    {
+                        if(previous.valid()) previous.get();
+                        work(*raw);
+                    });
+                inFlight.emplace_back(std::move(chunk), task->get_future().share());
+                pool.submit([task](){ (*task)(); });
+
+                if(inFlight.size() >= threads)
+                    retire();
+            }
+
+            while(inFlight.size())
+                retire();
+        }catch(...)
+        {
+            //Don't leave workers running on chunks which are about to be destroyed
+            for(auto& f : inFlight)
+                f.second.wait();
+            throw;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "rsa_container.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace rsa_engine
+{
+    //! Writes the lowest bytes of a value, most significant first
+    static void storeBigEndian(uint64_t value, unsigned char* out, size_t size)
+    {
+        for(size_t i=size; i>0; i--, value >>= 8)
+            out[i-1] = value & 0xFF;
+    }
+
+    //! Reads bytes as a big-endian value
+    static uint64_t loadBigEndian(const unsigned char* bytes, size_t size)
+    {
+        uint64_t value = 0;
+        for(size_t i=0; i<size; i++)
+            value = (value << 8) | bytes[i];
+        return value;
+    }
+
+    size_t modulusBytes(const mpz_class& n)
+    {
+        return (mpz_sizeinbase(n.get_mpz_t(), 2) + 7) / 8;
+    }
+
+    size_t messageBytes(const mpz_class& n)
+    {
+        return modulusBytes(n) - 1;
+    }
+
+    uint64_t fingerprint(const mpz_class& n)
+    {
+        std::vector<unsigned char> bytes(modulusBytes(n));
+        unpackBlock(n, bytes.data(), bytes.size());
+
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for(unsigned char b : bytes)
+        {
+            hash ^= b;
+            hash *= 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+    container_header makeHeader(const rsa_key& key, uint64_t blocks, uint64_t length, container_kind kind)
+    {
+        container_header header;
+        header.kind = kind;
+        header.width = modulusBytes(key.n);
+        header.fingerprint = fingerprint(key.n);
+        header.blocks = blocks;
+        header.length = length;
+        return header;
+    }
+
+    void storeHeader(const container_header& header, unsigned char* out)
+    {
+        std::copy(CONTAINER_MAGIC, CONTAINER_MAGIC + 3, out);
+        out[3] = (unsigned char)header.kind;
+        storeBigEndian(header.width, out + 4, 4);
+        storeBigEndian(header.fingerprint, out + 8, 8);
+        storeBigEndian(header.blocks, out + 16, 8);
+        storeBigEndian(header.length, out + 24, 8);
+    }
+
+    void loadHeader(const unsigned char* bytes, size_t size, container_header& header)
+    {
+        if(size < HEADER_SIZE)
+            throw std::runtime_error("The container is too short to have a header");
+        if(!std::equal(CONTAINER_MAGIC, CONTAINER_MAGIC + 3, bytes))
+            throw std::runtime_error("The input is not an RSA container");
+        if(bytes[3] != (unsigned char)container_kind::Blocks && bytes[3] != (unsigned char)container_kind::Session)
+            throw std::runtime_error("The container is of an unsupported kind");
+
+        header.kind = (container_kind)bytes[3];
+        header.width = loadBigEndian(bytes + 4, 4);
+        header.fingerprint = loadBigEndian(bytes + 8, 8);
+        header.blocks = loadBigEndian(bytes + 16, 8);
+        header.length = loadBigEndian(bytes + 24, 8);
+    }
+
+    bool matchesKey(const container_header& header, const rsa_key& key)
+    {
+        return header.width == modulusBytes(key.n) && header.fingerprint == fingerprint(key.n);
+    }
+}
@@ -0,0 +1,126 @@
+/*! \file
+
+\brief Binary container for RSA ciphertext
+
+Writing each encrypted block as hexadecimal text doubles the size of the ciphertext, and parsing the text back
+is a noticeable part of decryption. The container instead stores every block as a fixed-width big-endian number,
+so block \f$ i \f$ is always at the same offset and a mapped file can be split between threads without reading it first.
+
+Each block holds messageBytes() bytes of the message, one less than the width of \f$ n \f$, so every block is less than
+\f$ n \f$ whatever its bytes are. The last block is filled out with 0's, and the header records the length of the message
+so they are left out when it is decrypted.
+
+Layout, with every number big-endian
+    - bytes 0-3 : The magic value "RSA" followed by the kind of container
+    - bytes 4-7 : Width of each block in bytes; the number of bytes in \f$ n \f$
+    - bytes 8-15 : Fingerprint of the key's \f$ n \f$
+    - bytes 16-23 : Number of blocks
+    - bytes 24-31 : Length of the message in bytes; 0 for a session container
+    - byte 32 onwards : The blocks, each padded with 0's at the front to the full width
+
+Kinds of container
+    - 1, blocks : The whole message is encrypted with RSA, one block at a time
+    - 2, session : There is a single block, holding a session key wrapped with RSA (see rsa_hybrid.h), and the
+      blocks are followed by the message encrypted with the session key, which runs to the end of the container
+
+The fingerprint is the 64-bit FNV-1a hash of the bytes of \f$ n \f$. Public and private keys share \f$ n \f$, so
+it lets decryption say that the wrong key was given rather than writing garbage. It identifies a key but does not
+authenticate the ciphertext.
+
+The first byte of the magic value is not a hexadecimal digit or whitespace, so a container can be told apart from
+hexadecimal ciphertext by its first byte.
+*/
+#ifndef RSA_CONTAINER_H
+#define RSA_CONTAINER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <gmpxx.h>
+
+#include "rsa_engine.h"
+
+namespace rsa_engine
+{
+    //! Size of the container header in bytes
+    constexpr size_t HEADER_SIZE = 32;
+
+    //! First 3 bytes of every container
+    constexpr unsigned char CONTAINER_MAGIC[3] = {'R', 'S', 'A'};
+
+    //! Kinds of container; the 4th byte of the magic value
+    enum class container_kind : unsigned char {Blocks = 1, Session = 2};
+
+    //! The values in a container header
+    struct container_header
+    {
+        //! What the container holds
+        container_kind kind;
+        //! Width of each block in bytes
+        uint32_t width;
+        //! Fingerprint of the key's n
+        uint64_t fingerprint;
+        //! Number of blocks
+        uint64_t blocks;
+        //! Length of the message in bytes
+        uint64_t length;
+
+        container_header() : kind(container_kind::Blocks), width(0), fingerprint(0), blocks(0), length(0) {}
+    };
+
+    /*! Finds the number of bytes needed to hold any number below \f$ n \f$
+
+        \param[in] n The modulus
+        \returns size_t - The width of a block in a container
+    */
+    size_t modulusBytes(const mpz_class& n);
+
+    /*! Finds the number of bytes of a message held in each block of a container
+
+        \param[in] n The modulus; at least 256
+        \returns size_t - One less than modulusBytes(), so any block of that many bytes is less than \f$ n \f$
+    */
+    size_t messageBytes(const mpz_class& n);
+
+    /*! Fingerprints a key by its modulus
+
+        \param[in] n The modulus
+        \returns uint64_t - The 64-bit FNV-1a hash of the big-endian bytes of n
+    */
+    uint64_t fingerprint(const mpz_class& n);
+
+    /*! Fills in a header for a message encrypted with a key
+
+        \param[in] key The key; public or private
+        \param[in] blocks Number of blocks
+        \param[in] length Length of the message in bytes
+        \param[in] kind What the container holds
+        \returns container_header - The header
+    */
+    container_header makeHeader(const rsa_key& key, uint64_t blocks, uint64_t length, container_kind kind = container_kind::Blocks);
+
+    /*! Writes a header
+
+        \param[in] header The header
+        \param[out] out Where to write it; must have room for HEADER_SIZE bytes
+    */
+    void storeHeader(const container_header& header, unsigned char* out);
+
+    /*! Reads a header
+
+        \param[in] bytes The start of the container
+        \param[in] size Number of bytes available
+        \param[out] header The header
+        \throws runtime_error - If there are fewer than HEADER_SIZE bytes, or the magic value or kind is wrong
+    */
+    void loadHeader(const unsigned char* bytes, size_t size, container_header& header);
+
+    /*! Checks that a container can be decrypted with a key
+
+        \param[in] header The header of the container
+        \param[in] key The private key
+        \returns bool - Whether the fingerprint and block width match the key
+    */
+    bool matchesKey(const container_header& header, const rsa_key& key);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "rsa_engine.h"
+#include "cryptomath.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace rsa_engine
+{
+    void generateKey(uint64_t bits, std::mt19937_64& reng, rsa_key& publick, rsa_key& privatek)
+    {
+        //Choose e to be 65537
+        publick.de = 65537;
+
+        //Pick p until p % e is not 1
+        mpz_class p;
+        do
+        {
+            p = cryptomath::randomPrime<mpz_class, std::mt19937_64>(reng, bits/2);
+        }while(cryptomath::mod<mpz_class>(p, publick.de) == 1);
+
+        //Pick q the same way, and never equal to p, since n = p^2 is trivially factored
+        mpz_class q;
+        do
+        {
+            q = cryptomath::randomPrime<mpz_class, std::mt19937_64>(reng, bits-bits/2);
+        }while(cryptomath::mod<mpz_class>(q, publick.de) == 1 || q == p);
+
+        publick.n = privatek.n = p * q;
+
+        if(publick.n < 256)
+            throw std::logic_error("n less than 256, use more bits");
+
+        //Calculate d from phi(n)
+        privatek.de = cryptomath::inverseMod<mpz_class>(publick.de, (p - 1) * (q - 1));
+
+        //Keep the factors for CRT decryption
+        privatek.crt = true;
+        privatek.p = p;
+        privatek.q = q;
+        privatek.dP = cryptomath::mod<mpz_class>(privatek.de, p - 1);
+        privatek.dQ = cryptomath::mod<mpz_class>(privatek.de, q - 1);
+        privatek.qInv = cryptomath::inverseMod<mpz_class>(q, p);
+    }
+
+    uint64_t blockSize(const mpz_class& n)
+    {
+        mpz_class a = 1;
+        uint64_t p = 0;
+
+        while(a*255 < n)
+        {
+            a = a*256;
+            p++;
+        }
+
+        return p;
+    }
+
+    void packBlock(const unsigned char* bytes, size_t size, mpz_class& block)
+    {
+        mpz_import(block.get_mpz_t(), size, 1, 1, 1, 0, bytes);
+    }
+
+    void unpackBlock(const mpz_class& block, unsigned char* bytes, size_t size)
+    {
+        //mpz_sizeinbase counts 0 as 1 digit, but mpz_export writes nothing for it
+        size_t count = mpz_sgn(block.get_mpz_t()) ? (mpz_sizeinbase(block.get_mpz_t(), 2) + 7) / 8 : 0;
+        if(count > size)
+        {
+            std::vector<unsigned char> all(count);
+            mpz_export(all.data(), &count, 1, 1, 1, 0, block.get_mpz_t());
+            std::copy(all.end() - size, all.end(), bytes);
+            return;
+        }
+
+        std::fill(bytes, bytes + size - count, 0);
+        if(count)
+            mpz_export(bytes + size - count, &count, 1, 1, 1, 0, block.get_mpz_t());
+    }
+
+    void encryptBlock(mpz_class& block, const rsa_key& publick)
+    {
+        mpz_powm(block.get_mpz_t(), block.get_mpz_t(), publick.de.get_mpz_t(), publick.n.get_mpz_t());
+    }
+
+    void decryptBlock(mpz_class& block, const rsa_key& privatek, rsa_scratch& scratch)
+    {
+        if(!privatek.crt)
+        {
+            mpz_powm(block.get_mpz_t(), block.get_mpz_t(), privatek.de.get_mpz_t(), privatek.n.get_mpz_t());
+            return;
+        }
+
+        //Half-size exponentiations mod p and mod q
+        mpz_mod(scratch.m1.get_mpz_t(), block.get_mpz_t(), privatek.p.get_mpz_t());
+        mpz_powm(scratch.m1.get_mpz_t(), scratch.m1.get_mpz_t(), privatek.dP.get_mpz_t(), privatek.p.get_mpz_t());
+        mpz_mod(scratch.m2.get_mpz_t(), block.get_mpz_t(), privatek.q.get_mpz_t());
+        mpz_powm(scratch.m2.get_mpz_t(), scratch.m2.get_mpz_t(), privatek.dQ.get_mpz_t(), privatek.q.get_mpz_t());
+
+        //Recombine; m2 + hq is below n since h < p
+        mpz_sub(scratch.h.get_mpz_t(), scratch.m1.get_mpz_t(), scratch.m2.get_mpz_t());
+        mpz_mul(scratch.h.get_mpz_t(), scratch.h.get_mpz_t(), privatek.qInv.get_mpz_t());
+        mpz_mod(scratch.h.get_mpz_t(), scratch.h.get_mpz_t(), privatek.p.get_mpz_t());
+        mpz_set(block.get_mpz_t(), scratch.m2.get_mpz_t());
+        mpz_addmul(block.get_mpz_t(), scratch.h.get_mpz_t(), privatek.q.get_mpz_t());
+    }
+}
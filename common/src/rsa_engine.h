@@ -0,0 +1,119 @@
+/*! \file
+
+\brief RSA keys and the per-block work of encrypting and decrypting
+
+A message is split into blocks of blockSize() bytes, and each block is read as a big-endian number \f$ m \f$,
+encrypted as \f$ c = m^e \f$ mod \f$ n \f$, and decrypted back with \f$ m = c^d \f$ mod \f$ n \f$. Converting between bytes and
+numbers is done with GMP's mpz_import and mpz_export, which copy the bytes straight into the limbs of the number;
+building the number one byte at a time out of powers of 256 costs about as much as the exponentiation itself once
+keys reach a few thousand bits.
+
+When a private key has its CRT values, decryption uses two half-size exponentiations (see decryptBlock()).
+
+Every function which needs intermediate values takes them from an rsa_scratch, so a thread which keeps one
+scratch for all of its blocks doesn't allocate once the values have grown to full size.
+*/
+#ifndef RSA_ENGINE_H
+#define RSA_ENGINE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <random>
+#include <gmpxx.h>
+
+namespace rsa_engine
+{
+    //! Container for some \f$ n \f$ and either \f$ e \f$ or \f$ d \f$, and the CRT values of a private key
+    struct rsa_key
+    {
+        //! The modulus n
+        mpz_class n;
+        //! Either the encryption or decryption exponent
+        mpz_class de;
+
+        //! Whether the CRT values are set; only for private keys
+        bool crt;
+        //! The prime factor p of n
+        mpz_class p;
+        //! The prime factor q of n
+        mpz_class q;
+        //! d mod (p-1)
+        mpz_class dP;
+        //! d mod (q-1)
+        mpz_class dQ;
+        //! q^-1 mod p
+        mpz_class qInv;
+
+        rsa_key() : crt(false) {}
+    };
+
+    //! GMP values reused for every block a thread processes, so intermediate results don't allocate
+    struct rsa_scratch
+    {
+        //! The message mod p
+        mpz_class m1;
+        //! The message mod q
+        mpz_class m2;
+        //! The CRT recombination factor
+        mpz_class h;
+    };
+
+    /*! Generates an RSA public, private key pair
+
+        \f$ e \f$ is chosen to be 65537, and then distinct random primes \f$ p, q \f$ are generated with bits/2 bits
+        until \f$ gcd(p - 1, e) = gcd(q - 1, e) = 1 \f$. At that point, \f$ n \f$ and \f$ d \f$ can be calculated.
+        \f$ p, q \f$ and the CRT values derived from them are kept in the private key.
+
+        \param[in] bits Number of bits in \f$ n \f$
+        \param[in,out] reng Random number generator to pick the primes with
+        \param[out] publick The public key
+        \param[out] privatek The private key
+        \throws logic_error - If \f$ n \f$ is smaller than 256
+    */
+    void generateKey(uint64_t bits, std::mt19937_64& reng, rsa_key& publick, rsa_key& privatek);
+
+    /*! Calculates the number of bytes to use to build a single message \f$ m \f$
+
+        \param[in] n The value \f$ n \f$ that the message should be smaller than
+        \returns uint64_t - The number of bytes that can be used to build a message \f$ m \f$
+    */
+    uint64_t blockSize(const mpz_class& n);
+
+    /*! Reads bytes as a big-endian number
+
+        \param[in] bytes The bytes
+        \param[in] size Number of bytes
+        \param[out] block The number
+    */
+    void packBlock(const unsigned char* bytes, size_t size, mpz_class& block);
+
+    /*! Writes a number as big-endian bytes, padded with 0's at the front
+
+        If the number doesn't fit, only its lowest bytes are written.
+
+        \param[in] block The number
+        \param[out] bytes Where to write the bytes
+        \param[in] size Number of bytes to write
+    */
+    void unpackBlock(const mpz_class& block, unsigned char* bytes, size_t size);
+
+    /*! Encrypts a single block in place
+
+        \param[in,out] block The message \f$ m \f$; replaced by \f$ c = m^e \f$ mod \f$ n \f$
+        \param[in] publick The public key to encrypt with
+    */
+    void encryptBlock(mpz_class& block, const rsa_key& publick);
+
+    /*! Decrypts a single block in place, with the CRT values if the key has them
+
+        With \f$ q_{inv} = q^{-1} \f$ mod \f$ p \f$, \f$ m_1 = c^{d_P} \f$ mod \f$ p \f$, and \f$ m_2 = c^{d_Q} \f$ mod \f$ q \f$,
+        the message is \f$ m = m_2 + q(q_{inv}(m_1 - m_2) \f$ mod \f$ p) \f$.
+
+        \param[in,out] block The encrypted block \f$ c \f$; replaced by the message \f$ m = c^d \f$ mod \f$ n \f$
+        \param[in] privatek The private key to decrypt with
+        \param[in,out] scratch Values to hold the intermediate results
+    */
+    void decryptBlock(mpz_class& block, const rsa_key& privatek, rsa_scratch& scratch);
+}
+
+#endif
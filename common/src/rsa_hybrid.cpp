@@ -0,0 +1,113 @@
+#include "rsa_hybrid.h"
+#include "rsa_container.h"
+#include "des64_engine.h"
+#include "des64_modes.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace des64_engine;
+
+namespace rsa_engine
+{
+    //! Reads 8 bytes as a big-endian block
+    static uint64_t loadBlock(const unsigned char* bytes)
+    {
+        uint64_t block = 0;
+        for(int i=0; i<8; i++)
+            block = (block << 8) | bytes[i];
+        return block;
+    }
+
+    //! Writes a block as 8 big-endian bytes
+    static void storeBlock(uint64_t block, unsigned char* bytes)
+    {
+        for(int i=7; i>=0; i--, block >>= 8)
+            bytes[i] = block & 0xFF;
+    }
+
+    session_key randomSession()
+    {
+        std::random_device rd;
+        auto random64 = [&](){ return ((uint64_t)rd() << 32) | rd(); };
+
+        session_key session;
+        for(uint64_t& key : session.keys)
+            key = setParity(random64());
+        session.iv = random64();
+        return session;
+    }
+
+    void wrapSession(const session_key& session, const rsa_key& publick, unsigned char* out)
+    {
+        size_t chars = blockSize(publick.n);
+        if(chars <= SESSION_BYTES)
+            throw std::runtime_error("The key is too small to wrap a session key; use at least 512 bits");
+
+        std::vector<unsigned char> message(chars);
+        std::random_device rd;
+        for(size_t i=0; i<chars - SESSION_BYTES; i++)
+            message[i] = rd();
+        message[0] %= 0xFF;
+
+        unsigned char* tail = message.data() + chars - SESSION_BYTES;
+        for(int i=0; i<3; i++)
+            storeBlock(session.keys[i], tail + 8*i);
+        storeBlock(session.iv, tail + 24);
+
+        mpz_class block;
+        packBlock(message.data(), chars, block);
+        encryptBlock(block, publick);
+        unpackBlock(block, out, modulusBytes(publick.n));
+    }
+
+    session_key unwrapSession(const unsigned char* wrapped, const rsa_key& privatek, rsa_scratch& scratch)
+    {
+        mpz_class block;
+        packBlock(wrapped, modulusBytes(privatek.n), block);
+        if(block >= privatek.n)
+            throw std::runtime_error("The wrapped session key is not less than n");
+
+        decryptBlock(block, privatek, scratch);
+        unsigned char tail[SESSION_BYTES];
+        unpackBlock(block, tail, SESSION_BYTES);
+
+        session_key session;
+        for(int i=0; i<3; i++)
+        {
+            session.keys[i] = loadBlock(tail + 8*i);
+            if(!parityValid(session.keys[i]))
+                throw std::runtime_error("The session key did not unwrap to valid DES keys");
+        }
+        session.iv = loadBlock(tail + 24);
+        return session;
+    }
+
+    void applyKeyStream(const key_schedule& keys, uint64_t counter, const unsigned char* in,
+                        unsigned char* out, size_t size, uint64_t* blocks, uint64_t* scratch)
+    {
+        size_t full = size / 8, part = size % 8;
+        for(size_t i=0; i<full; i++)
+            blocks[i] = loadBlock(in + 8*i);
+
+        //A partial block is filled out with 0's; only its first bytes are kept
+        unsigned char last[8] = {0};
+        if(part)
+        {
+            std::copy(in + 8*full, in + size, last);
+            blocks[full] = loadBlock(last);
+        }
+
+        processChunk(cipher_mode::CTR, true, DEFAULT_BACKEND, keys, blocks, full + (part ? 1 : 0), counter, scratch);
+
+        for(size_t i=0; i<full; i++)
+            storeBlock(blocks[i], out + 8*i);
+        if(part)
+        {
+            storeBlock(blocks[full], last);
+            std::copy(last, last + part, out + 8*full);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*! \file
+
+\brief Hybrid encryption; a session key wrapped with RSA, and the message encrypted with triple DES
+
+Every RSA block costs a modular exponentiation, so encrypting a large file block by block is limited to a few
+hundred kilobytes per second. Instead, a random session key is made for each message and only it is encrypted with
+RSA; the message itself is encrypted with the session key, so it is processed as fast as the block cipher allows.
+
+The session is three independent DES keys and an IV, which are used for triple DES (EDE) in CTR mode (see
+des64_modes.h). CTR needs no padding, so the encrypted message is exactly as long as the message, and every block
+of it can be processed independently, so large files are split between threads like any other chunked input.
+
+The session is wrapped as a single RSA message of blockSize() bytes: random bytes, then the three keys and the IV,
+each 8 bytes big-endian. The random bytes fill the block so the message is never much smaller than \f$ n \f$; the
+first of them is kept below 0xFF so the message is always less than \f$ n \f$. This is not a standard padding scheme
+such as OAEP; it only keeps every wrapped session different and the same size as \f$ n \f$.
+*/
+#ifndef RSA_HYBRID_H
+#define RSA_HYBRID_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "des64_keyschedule.h"
+#include "rsa_engine.h"
+
+namespace rsa_engine
+{
+    //! Number of bytes of the session in a wrapped message
+    constexpr size_t SESSION_BYTES = 32;
+
+    //! The keys and IV for the bulk cipher of one message
+    struct session_key
+    {
+        //! Triple DES keys, with valid parity
+        uint64_t keys[3];
+        //! Starting counter for CTR mode
+        uint64_t iv;
+
+        session_key() : keys{0, 0, 0}, iv(0) {}
+    };
+
+    /*! Makes a session from std::random_device
+
+        \returns session_key - Three random DES keys with their parity set, and a random IV
+    */
+    session_key randomSession();
+
+    /*! Wraps a session with a public key
+
+        \param[in] session The session
+        \param[in] publick The public key
+        \param[out] out Where to write the wrapped session; modulusBytes() bytes
+        \throws runtime_error - If the key is too small to hold a session
+    */
+    void wrapSession(const session_key& session, const rsa_key& publick, unsigned char* out);
+
+    /*! Unwraps a session with a private key
+
+        \param[in] wrapped The wrapped session; modulusBytes() bytes
+        \param[in] privatek The private key
+        \param[in,out] scratch Values to hold the intermediate results
+        \returns session_key - The session
+        \throws runtime_error - If the wrapped session is not less than n, or doesn't unwrap to keys with valid parity
+    */
+    session_key unwrapSession(const unsigned char* wrapped, const rsa_key& privatek, rsa_scratch& scratch);
+
+    /*! Encrypts or decrypts part of a message with the session's key stream; both are the same in CTR mode
+
+        \param[in] keys Key schedule made from the session's keys
+        \param[in] counter The counter for the first block; the IV plus the number of blocks before this part
+        \param[in] in The bytes to process
+        \param[out] out Where to write the processed bytes; may be the same as in
+        \param[in] size Number of bytes. Only the last part of a message may have a partial block
+        \param[out] blocks Space for (size + 7) / 8 blocks
+        \param[out] scratch Space for (size + 7) / 8 blocks
+    */
+    void applyKeyStream(const des64_engine::key_schedule& keys, uint64_t counter, const unsigned char* in,
+                        unsigned char* out, size_t size, uint64_t* blocks, uint64_t* scratch);
+}
+
+#endif
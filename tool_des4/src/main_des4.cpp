@@ -33,6 +33,10 @@ Mode Options
     - -d : To decrypt
     - -c3 : Crack a 3-round encryption
     - -c4 n : Crack a 4-round encryption with at n plainttexts
+    - -kp rounds : Recover the key from known plaintext/ciphertext pairs encrypted with the given number of rounds
+    - -kb rounds : Recover the keys for a batch of sets of pairs encrypted with the given number of rounds
+    - -kq rounds n : Recover the key by having the oracle encrypt n chosen plaintexts, encrypted with the given number of rounds
+    - -bm : Encrypt and decrypt the files listed in a manifest, given as the input
 
 Input Options
     - -it text : To input the text 'text'
@@ -45,10 +49,93 @@ Output Options
 Key Options
     - -k key : The key to use, written as 9 bits
 
+Oracle Options
+    - -ok key : Attack a simulated oracle with the hidden key 'key', written as 9 bits, or "random" for a random key
+    - -oc command : Attack an oracle run as the command 'command'
+
+Padding Options
+    - -p scheme : How to pad the last unit; one of zeros, pkcs7. Defaults to zeros
+
+Other Options
+    - -j n : Recover keys for a batch, process the files of a manifest, or run experiments, on n threads; 0 uses one thread per core. Defaults to 1
+    - -experiments n : Run n attacks against simulated oracles with random keys and report how often they succeed
+    - -seed s : Seed for the keys of the experiments. Defaults to 1
+
 When input mode is -it, it is expected that the input is a single block (64-bits) in hexadecimal
 When output mode is -ot, data will be outputted in hexadecimal
 Cracking the 3-round encryption usually requires about 6 plaintexts to be encrypted
 Cracking the 4-round encryption is likely to fail with small numbers of plaintexts
+
+\subsection recover_des4 Key Recovery
+The crack modes ask for each chosen plaintext to be encrypted interactively. When the plaintext/ciphertext pairs
+are already known, -kp and -kb recover the key without any interaction by trying all 512 keys against every pair
+(see des4_keysearch.h). Blocks are written as 3 hexadecimal digits.
+
+With -kp, the input is a list of pairs separated by whitespace, each a plaintext block followed by its ciphertext block.
+Every key which encrypts each plaintext to its ciphertext is written as "Key: " followed by its 9 bits.
+\verbatim
+tool_des4 -kp 4 -it "123 a4f 5e0 3b1 0ff 8c2" -ot
+\endverbatim
+
+With -kb, each line of the input is one case; a name, followed by its pairs. For each case, one line is written
+with the name followed by the matching keys separated by commas, "none" if no key matches, or "invalid" if the
+line could not be read. A table of every block encrypted under every key is built once, after which thousands of
+cases can be checked per second; -j splits both the table and the cases between threads. Empty lines and lines
+starting with # are skipped.
+\verbatim
+student1 123 a4f 5e0 3b1
+student2 7c4 019 e2e 4d5 001 b3a
+\endverbatim
+
+When the input file is a regular file, it is memory mapped instead of read through a stream. If the output file
+is also a regular file (or does not exist yet), it is created at its final size and memory mapped as well, and data is
+transformed directly from one mapping to the other. Pipes and other special files are read and written with streams.
+
+\subsection manifest_des4 Manifests
+With -bm, the input is a manifest of files to encrypt or decrypt, so a whole set of files can be processed by one run
+of the tool. Each line is one entry: the operation (e or d), the number of rounds, the key as 9 bits, the input
+file, and the output file. File names can't contain whitespace. Empty lines and lines starting with # are skipped.
+\verbatim
+e 4 101100111 notes/a.txt enc/a.des4
+d 3 010101010 enc/b.des4 notes/b.txt
+\endverbatim
+Each file is processed from start to finish by one thread, mapped or streamed the same way as with -if and -of,
+and -j files are processed at once. A summary line is written for each entry, in the order of the manifest, with the
+number of bytes processed, the time taken, and the throughput, or why the entry failed; a line with the totals follows.
+An entry which fails doesn't stop the others, but the tool exits with an error. Since entries are processed at
+the same time, an entry shouldn't read a file written by another entry of the same manifest.
+
+\subsection oracle_des4 Oracles
+The crack modes and -kq need chosen plaintexts encrypted with the unknown key, by an oracle (see des4_oracle.h).
+By default, the oracle is the user; each block is printed, and its encryption is typed in. With -ok, a simulated
+oracle holds the given key instead, and the hidden key is printed along with the cracked one. With -oc, the command
+is run with /bin/sh and each block is written to its stdin as a line of 3 hexadecimal digits; it must write each
+encrypted block to its stdout the same way. -kq asks for all of its plaintexts at once, so a command only has to
+answer one batch. The number of blocks the oracle encrypted is printed after the key.
+\verbatim
+tool_des4 -c3 -ok random
+tool_des4 -kq 4 8 -oc "./my_oracle"
+\endverbatim
+
+With -experiments, the attack is run many times against simulated oracles, each with a key drawn from a generator seeded with
+-seed, so the same experiment can be repeated exactly. The experiments are split between the threads given with -j,
+and the number of successful attacks, the success rate, and the mean number of queries are printed. An attack
+succeeds when it finds exactly the hidden key; cracks which give up count as failures. This measures how the
+success rate of -c4 depends on its number of plaintexts.
+\verbatim
+tool_des4 -c4 10 -experiments 10000 -j 0
+\endverbatim
+
+\subsection padding_des4 Padding
+Data is processed 3 bytes (two blocks) at a time. By default, a message whose length is not a multiple of 3 has its
+last unit filled out with 0's, so decrypting it gives back up to 2 extra bytes. With -p pkcs7, encryption always
+appends 1 to 3 bytes, each holding the number of bytes appended, and decryption checks and removes them, so a message
+decrypts to exactly the bytes that were encrypted. Only the last unit is held back and handled separately, so the rest
+of the message is processed the same way either way. If the padding is invalid, the tool terminates. The same padding
+is used for every entry of a -bm manifest.
+
+Since a block is only 12 bits, the encryption and decryption of all 4096 blocks are computed once for the given key
+and number of rounds (see des4_codebook.h), and the data is transformed by looking each block up in those tables.
 */
 #include <iostream>
 #include <string>
@@ -57,11 +144,27 @@ Cracking the 4-round encryption is likely to fail with small numbers of plaintex
 #include <cctype>
 #include <functional>
 #include <stdexcept>
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <csignal>
 
 #include "des4.h"
+#include "des4_codebook.h"
+#include "des4_keysearch.h"
+#include "des4_oracle.h"
+#include "mapped_file.h"
+#include "hex_codec.h"
+#include "parallel.h"
 
 using namespace std;
+using namespace hex_codec;
 using namespace des4;
+using namespace des4_engine;
 
 //! Enums for the tool
 namespace enums_des4 {
@@ -72,11 +175,96 @@ namespace enums_des4 {
     enum class Output{None, File, Term};
 
     //! Mode options
-    enum class Mode{None, Encrypt, Decrypt, Crack3, Crack4};
+    enum class Mode{None, Encrypt, Decrypt, Crack3, Crack4, Recover, RecoverBatch, Query, Batch};
+
+    //! Oracle options
+    enum class Oracle{Terminal, Simulated, Pipe};
+
+    //! Padding options
+    enum class Padding{Zeros, PKCS7};
 }
 
 using namespace enums_des4;
 
+//! Number of 3-byte units read, processed, and written at a time when streaming
+const size_t CHUNK_UNITS = 1 << 14;
+
+//! Number of cases given to a thread at a time in a key recovery batch
+const size_t BATCH_CASES = 1024;
+
+//! Number of attacks given to a thread at a time when running experiments
+const size_t EXPERIMENT_CASES = 64;
+
+//! Options for the oracle used by the crack modes
+struct oracle_args
+{
+    //! Which oracle to use
+    Oracle kind;
+
+    //! Hidden key of a simulated oracle, as 9 bits or "random"
+    string key;
+
+    //! Command to run for a pipe oracle
+    string command;
+
+    //! Number of chosen plaintexts for -kq
+    uint64_t queries;
+
+    //! Number of experiments to run; 0 to attack a single oracle
+    uint64_t experiments;
+
+    //! Seed for the keys of the experiments
+    uint32_t seed;
+};
+
+//! A piece of a set of experiments
+struct experiment_chunk
+{
+    //! Hidden keys to attack
+    vector<uint16_t> keys;
+
+    //! Number of attacks which found the hidden key
+    uint64_t successes;
+
+    //! Total number of blocks encrypted by the oracles
+    uint64_t queries;
+};
+
+//! Oracle which asks the user to encrypt each block
+class terminal_oracle : public oracle
+{
+protected:
+    void query(const uint16_t* blocks, uint16_t* out, size_t count) override;
+};
+
+//! One entry of a manifest of files
+struct file_entry
+{
+    //! The manifest line
+    string line;
+
+    //! Line of the summary for the entry
+    string summary;
+
+    //! Number of bytes processed
+    uint64_t bytes;
+
+    //! Whether the entry was processed
+    bool ok;
+
+    file_entry() : bytes(0), ok(false) {}
+};
+
+//! A piece of a key recovery batch
+struct batch_chunk
+{
+    //! Lines read from the input
+    vector<string> lines;
+
+    //! Result lines to write
+    string results;
+};
+
 /*! Processes the command line arguments
 
 If the arguments are invalid, a usage prompt is printed with an error message
@@ -86,13 +274,16 @@ If the arguments are invalid, a usage prompt is printed with an error message
 \param[out] inMode Mode of input
 \param[out] outMode Mode of output
 \param[out] op The operation to perform
-\param[out] trials Number of plaintexts to use for the 4-round crack
+\param[out] trials Number of plaintexts to use for the 4-round crack, or rounds to encrypt, decrypt, or recover keys with
 \param[out] key The key to use for encryption or decryption
 \param[out] input String to process if text mode, file name if file mode
 \param[out] output File name to output to
+\param[out] pad How to pad the last unit
+\param[out] threads Number of threads to recover keys for a batch or run experiments with
+\param[out] oracleArgs Options for the oracle
 \returns bool - Whether or not the arguments were valid
 */
-bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, uint64_t& trials, string& key, string& input, string& output);
+bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, uint64_t& trials, string& key, string& input, string& output, Padding& pad, unsigned& threads, oracle_args& oracleArgs);
 
 /*! Prints the program usage prompt with an error message
 
@@ -101,19 +292,123 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
 */
 void help(string name, string msg = "");
 
-/*! Converts hexadecimal values to a string of characters. Each character is made from two hex values.
+/*! Encrypts or decrypts data 3 bytes (two 12-bit blocks) at a time by looking each block up in a codebook table
+
+If the size is not a multiple of 3, the last unit is padded with 0's, so
+the output must have room for the size rounded up to a multiple of 3
+
+\param[in] in Data to process
+\param[out] out Where to write the processed data. May be the same as in
+\param[in] size Number of bytes of data
+\param[in] table The encrypt or decrypt table of a codebook
+*/
+void transformUnits(const uint8_t* in, uint8_t* out, size_t size, const uint16_t* table);
+
+/*! Encrypts or decrypts the last unit of a message, adding or removing its padding
+
+\param[in] in The bytes after the last full unit, or the last unit itself when removing pkcs7 padding
+\param[out] out Where to write the processed bytes; must have room for 3 bytes. May be the same as in
+\param[in] size Number of bytes in in; less than 3, or exactly 3 when removing pkcs7 padding
+\param[in] table The encrypt or decrypt table of a codebook
+\param[in] pad How the last unit is padded
+\param[in] encrypting Whether the padding is being added or removed
+\returns size_t - Number of bytes written to out
+\throws runtime_error - If the pkcs7 padding is invalid, or the message is not a multiple of 3 bytes
+*/
+size_t transformTail(const uint8_t* in, uint8_t* out, size_t size, const uint16_t* table, Padding pad, bool encrypting);
+
+/*! Finds the size of the output for an input size, if it can be known before processing
+
+\param[in] pad How the last unit is padded
+\param[in] encrypting Whether the padding is being added or removed
+\param[in] size Size of the input in bytes
+\param[out] out Size of the output in bytes
+\returns bool - Whether the size is known; it isn't when removing pkcs7 padding, since it depends on the last unit
+*/
+bool outputSize(Padding pad, bool encrypting, uint64_t size, uint64_t& out);
+
+/*! Encrypts or decrypts everything from an input to an output with a codebook table
+
+Mapped input is processed straight into mapped output. Otherwise, data is read, transformed, and written
+CHUNK_UNITS units at a time. The bytes after the last full unit, along with the last unit itself when removing
+pkcs7 padding, are held back and processed with transformTail once the input ends.
+
+\param[in] inMap The mapped input, if it is mapped
+\param[in] inStream The input, if it is not mapped
+\param[in] outMap The mapped output, if it is mapped; it must be the size given by outputSize
+\param[in] outStream The output, if it is not mapped
+\param[in] outMode Mode of output; the terminal is written in hexadecimal
+\param[in] table The encrypt or decrypt table of a codebook
+\param[in] pad How the last unit is padded
+\param[in] encrypting Whether the padding is being added or removed
+\returns uint64_t - Number of bytes read
+\throws runtime_error - If the pkcs7 padding is invalid
+*/
+uint64_t transformData(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream, Output outMode, const uint16_t* table, Padding pad, bool encrypting);
+
+/*! Reads known pairs; whitespace separated blocks of up to 3 hexadecimal digits, alternating plaintext and ciphertext
 
-\param[in] input Characters to convert
-\returns string - The ASCII output
+\param[in] in Stream to read from
+\param[out] pairs The pairs read
+\returns bool - Whether or not everything in the stream was a valid pair
 */
-string charsFromHex(string input);
+bool readPairs(istream& in, vector<known_pair>& pairs);
 
-/*! Converts characters to hexadecimal values. Each character becomes two values
+/*! Writes keys as 9 bits each, separated by a string
 
-\param[in] input Characters to convert
-\returns string - The hexadecimal output
+\param[in] keys The keys
+\param[in] separator What to write between keys
+\returns string - The keys
 */
-string hexFromChars(string input);
+string keysToString(const vector<uint16_t>& keys, const string& separator);
+
+/*! Recovers the key for one line of a key recovery batch
+
+\param[in] line The line; a name followed by pairs
+\param[in] table Table of every block under every key
+\returns string - The result line, or nothing if the line was empty or a comment
+*/
+string recoverLine(const string& line, const key_table& table);
+
+/*! Encrypts or decrypts the file of one manifest entry on the calling thread
+
+An entry is a line of the form "operation rounds key input output", where operation is e or d and key is 9 bits.
+The files are opened the same way as -if and -of.
+
+\param[in,out] entry The entry; its summary, bytes, and ok are filled in
+\param[in] pad How the last unit is padded
+*/
+void runFileEntry(file_entry& entry, Padding pad);
+
+/*! Attacks an oracle with one of the crack modes or with -kq
+
+\param[in] op Crack3, Crack4, or Query
+\param[in] trials Number of plaintexts for Crack4, or rounds for Query
+\param[in] queries Number of chosen plaintexts for Query
+\param[in] box The oracle
+\returns vector<uint16_t> - The keys found. The crack modes find exactly one
+\throws runtime_error - If a crack gives up, or the oracle fails
+*/
+vector<uint16_t> attack(Mode op, uint64_t trials, uint64_t queries, oracle& box);
+
+/*! Attacks an oracle and writes the key found, or why the attack failed, and the number of blocks the oracle encrypted
+
+\param[in] op Crack3, Crack4, or Query
+\param[in] trials Number of plaintexts for Crack4, or rounds for Query
+\param[in] queries Number of chosen plaintexts for Query
+\param[in] box The oracle
+*/
+void crackOracle(Mode op, uint64_t trials, uint64_t queries, oracle& box);
+
+/*! Attacks simulated oracles with keys from a seeded generator and writes how often the attack succeeds
+
+\param[in] op Crack3, Crack4, or Query
+\param[in] trials Number of plaintexts for Crack4, or rounds for Query
+\param[in] args Number of experiments, seed, and number of chosen plaintexts for Query
+\param[in] threads Number of threads to run the experiments on
+*/
+void runExperiments(Mode op, uint64_t trials, const oracle_args& args, unsigned threads);
+
 
 /*!
     Processes the command line arguments. If they are invalid, the application terminates. 
@@ -121,14 +416,27 @@ string hexFromChars(string input);
     The key is converted from binary to a 9-bit value. If it is not 9 bits long,
     the application terminates.
 
-    Any files that will be used are opened. If text is used as the input, it is copied
-    into an input stream. If a file fails to open, the application terminates.
+    Any files that will be used are opened; regular files are memory mapped, and anything else is
+    opened as a stream. If text is used as the input, it is copied into an input stream. If a file fails
+    to open, the application terminates.
 
-    In encrypt or decrypt mode data is processed 3 bytes at a time (6 if reading hexadecimal) to generate 2 blocks for the algorithm
-    and written it is to the output in the same format. If 6 bytes are not available, 0's are appended
+    In encrypt or decrypt mode the codebook for the key and number of rounds is built first, so that each block is
+    a single table lookup. Data is processed 3 bytes at a time (6 if reading hexadecimal) to generate 2 blocks for the algorithm
+    and written it is to the output in the same format. If 6 bytes are not available, the last unit is padded (see transformTail). Mapped input
+    is processed straight out of the mapping, and mapped output is written in place; streams are read and written
+    CHUNK_UNITS units at a time.
+
+    In manifest mode, the manifest is read and each entry is handed to a thread, which processes the whole file
+    (see runFileEntry). The summary is written in the order of the manifest.
+
+    In key recovery mode, the pairs are read from the input and the keys which match them are written to the output.
+    In batch mode, the table of every block under every key is built, and lines are read BATCH_CASES at a time and
+    handed to the threads; results are written in the same order as the input.
 
     In cracker mode, the application prompts with a block of data to encrypt using the machine to crack. The user
     shoudl encrypt that data and enter the result. This continues until the cracker finishes, errors, or gives up.
+    A simulated oracle or a command can answer instead of the user. In experiment mode, the attack is run against
+    simulated oracles EXPERIMENT_CASES at a time on each thread, and the results are added up.
 
     \param[in] argc Number of command line arguments
     \param[in] argv The command line arguments
@@ -137,24 +445,36 @@ string hexFromChars(string input);
     \returns 2 - A file could not be opened
     \returns 3 - The key was the wrong size or not binary
     \returns 4 - The input was supposed to be hexadecmal, but was not valid
+    \returns 5 - The oracle command could not be started
+    \returns 6 - An entry of the manifest failed
+    \returns 7 - The padding was invalid
 */
 int main(int argc, char** argv)
 {
     string key, input, output;
     uint64_t trials;
+    unsigned threads;
     Input inputMode;
     Output outputMode;
     Mode operation;
+    Padding pad;
+    oracle_args oracleArgs;
 
     stringstream inText;
 
     ifstream inFile;
     ofstream outFile;
 
+    mapped_file inMap;
+    mapped_file outMap;
+
     istream* inStream = &inText;
     ostream* outStream = &cout;
 
-    if(!processArgs(argc, argv, inputMode, outputMode, operation, trials, key, input, output))
+    //A pipe oracle which exits early should be an error, not a signal that kills the tool
+    signal(SIGPIPE, SIG_IGN);
+
+    if(!processArgs(argc, argv, inputMode, outputMode, operation, trials, key, input, output, pad, threads, oracleArgs))
     {
         return 1;
     }
@@ -171,7 +491,7 @@ int main(int argc, char** argv)
         for(int i=0; i<9; i++)
             key_val |= ((key[i] - '0') << 8 - i);
 
-        if(inputMode == Input::File)
+        if(inputMode == Input::File && !inMap.openRead(input))
         {
             inFile.open(input, ios::binary);
             if(!inFile)
@@ -182,7 +502,7 @@ int main(int argc, char** argv)
 
             inStream = &inFile;
         }
-        else
+        else if(inputMode != Input::File)
         {
             try
             {
@@ -194,7 +514,17 @@ int main(int argc, char** argv)
             }
         }
 
-        if(outputMode == Output::File)
+        if(inputMode == Input::File && outputMode == Output::File && sameFile(input, output))
+        {
+            help(argv[0], "The output file can't be the input file");
+            inFile.close();
+            return 2;
+        }
+
+        //The output size is known if the input is mapped, unless it depends on the padding in the last unit
+        uint64_t outSize;
+        if(outputMode == Output::File && !(inMap.isOpen() && outputSize(pad, operation == Mode::Encrypt, inMap.size(), outSize)
+                                           && outMap.openWrite(output, outSize)))
         {
             outFile.open(output, ios::binary | ios::trunc);
             if(!outFile)
@@ -207,87 +537,211 @@ int main(int argc, char** argv)
             outStream = &outFile;
         }
 
-        function<uint16_t(uint16_t, const uint16_t&, const uint16_t&)> op = (operation == Mode::Encrypt ? encrypt : decrypt);
+        //Every block this key and number of rounds can produce, computed once
+        codebook book(key_val, trials);
+        const uint16_t* table = (operation == Mode::Encrypt ? book.encryptTable() : book.decryptTable());
 
-        uint8_t blocks[3];
-        while(*inStream)
+        try
+        {
+            transformData(inMap, inStream, outMap, outStream, outputMode, table, pad, operation == Mode::Encrypt);
+        }catch(runtime_error& ex)
         {
-            blocks[0] = blocks[1] = blocks[2] = 0;
-            inStream->read((char*)blocks, 3);
+            cerr << ex.what() << endl;
 
-            if(!*inStream && !inStream->gcount()) break;
+            //Don't leave a partly written or zero-filled output behind
+            outMap.close();
+            outFile.close();
+            if(outputMode == Output::File)
+                discardOutput(output);
+            return 7;
+        }
 
-            uint16_t block1 = (blocks[0] << 4) | (blocks[1] >> 4);
-            uint16_t block2 = (blocks[1] << 8) | blocks[2];
+        inFile.close();
+        outFile.close();
+    }
+    else if(operation == Mode::Recover || operation == Mode::RecoverBatch || operation == Mode::Batch)
+    {
+        if(inputMode == Input::File)
+        {
+            inFile.open(input);
+            if(!inFile)
+            {
+                help(argv[0], "Unable to open input file " + input);
+                return 2;
+            }
 
-            block1 = op(block1, key_val, trials);
-            block2 = op(block2, key_val, trials);
+            inStream = &inFile;
+        }
+        else
+        {
+            inText << input;
+        }
 
-            blocks[0] = (block1 & 0xFF0) >> 4;
-            blocks[1] = ((block1 & 0xF) << 4) | ((block2 & 0xF00) >> 8);
-            blocks[2] = (block2 & 0xFF);
-            
-            if(outputMode == Output::File)
+        if(outputMode == Output::File)
+        {
+            outFile.open(output, ios::trunc);
+            if(!outFile)
             {
-                outStream->write((char*)blocks, 3);
+                help(argv[0], "Unable to open output file " + output);
+                inFile.close();
+                return 2;
             }
+
+            outStream = &outFile;
+        }
+
+        if(operation == Mode::Recover)
+        {
+            vector<known_pair> pairs;
+            if(!readPairs(*inStream, pairs) || pairs.empty())
+            {
+                help(argv[0], "Pairs must be blocks of up to 3 hexadecimal digits, each plaintext followed by its ciphertext");
+                return 4;
+            }
+
+            vector<uint16_t> keys = recoverKeys(pairs.data(), pairs.size(), trials);
+            if(keys.empty())
+                *outStream << "No key matches every pair" << endl;
             else
+                *outStream << "Key: " << keysToString(keys, "\nKey: ") << endl;
+        }
+        else if(operation == Mode::Batch)
+        {
+            uint64_t entries = 0, failed = 0, bytes = 0;
+
+            auto start = chrono::steady_clock::now();
+            parallel::ordered<file_entry>(threads,
+                [&](file_entry& e)
+                {
+                    while(getline(*inStream, e.line))
+                    {
+                        size_t first = e.line.find_first_not_of(" \t\r");
+                        if(first != string::npos && e.line[first] != '#')
+                            return true;
+                    }
+                    return false;
+                },
+                [&](file_entry& e)
+                {
+                    runFileEntry(e, pad);
+                },
+                [&](file_entry& e)
+                {
+                    entries++;
+                    failed += !e.ok;
+                    bytes += e.bytes;
+                    *outStream << e.summary << flush;
+                });
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            *outStream << "Total: " << entries << " files (" << failed << " failed), " << bytes << " bytes in " << seconds
+                       << " s (" << (seconds > 0 ? bytes / seconds / 1e6 : 0) << " MB/s)" << endl;
+
+            if(failed)
             {
-                *outStream << hexFromChars(string((char*)blocks, 3));
+                inFile.close();
+                outFile.close();
+                return 6;
             }
         }
+        else
+        {
+            key_table table(trials, threads);
+            parallel::ordered<batch_chunk>(threads,
+                [&](batch_chunk& c)
+                {
+                    c.lines.clear();
+                    string line;
+                    while(c.lines.size() < BATCH_CASES && getline(*inStream, line))
+                        c.lines.push_back(line);
+                    return !c.lines.empty();
+                },
+                [&](batch_chunk& c)
+                {
+                    c.results.clear();
+                    for(const string& line : c.lines)
+                        c.results += recoverLine(line, table);
+                },
+                [&](batch_chunk& c)
+                {
+                    *outStream << c.results;
+                });
+        }
 
         inFile.close();
         outFile.close();
     }
+    else if(oracleArgs.experiments)
+    {
+        runExperiments(operation, trials, oracleArgs, threads);
+    }
     else
     {
-        cout << "The cracker will give you a 12-bit block to encrypt as 3 hexadecimal digits" << endl;
-        cout << "Encrypt the block and enter the 12-bit block that results as 3 hexadecimal digits" << endl;
-        function<uint16_t(uint16_t)> box =
-        [](uint16_t block)
+        if(oracleArgs.kind == Oracle::Simulated)
         {
-            char block_c[2] = {(char)(block >> 8), (char)(block & 0xFF)};
-            cout << "Encrypt " << hexFromChars(string((char*)block_c, 2)).substr(1) << endl << "> " << flush;
-
-            string in;
-            bool valid;
-            do
+            uint16_t key_val = 0;
+            if(oracleArgs.key == "random")
             {
-                valid = true;
-                cin >> in;
-                if(in.size() != 3 || in.find_first_not_of("0123456789abcdef") != string::npos)
-                {
-                    cout << "Enter 3 hexadecimal digits" << endl << "> " << flush;
-                    valid = false;
-                }
-            }while(!valid);
+                key_val = random_device()() % KEYS;
+            }
+            else if(oracleArgs.key.find_first_not_of("01") != string::npos || oracleArgs.key.size() != 9)
+            {
+                help(argv[0], "Oracle key must contain exactly 9 characters from the set [\'0\', \'1\'], or be random");
+                return 3;
+            }
+            else
+            {
+                for(int i=0; i<9; i++)
+                    key_val |= ((oracleArgs.key[i] - '0') << 8 - i);
+            }
 
-            in = charsFromHex(in);
-            block = ((in[0] << 4) & 0x0FF0) | ((in[1] >> 4) & 0x000F);
-            return block;
-        };
+            simulated_oracle box(key_val, operation == Mode::Crack3 ? 3 : operation == Mode::Crack4 ? 4 : trials);
+            crackOracle(operation, trials, oracleArgs.queries, box);
 
-        function<uint16_t(function<uint16_t(uint16_t)>)> cracker = crack3;
-        if(operation == Mode::Crack4) cracker = std::bind(crack4, placeholders::_1, trials);
+            //Written the same way as the key found
+            if(operation == Mode::Query)
+                cout << "Hidden key: " << keysToString({key_val}, "") << endl;
+            else
+                cout << "Hidden key: " << hex << key_val << dec << endl;
+        }
+        else if(oracleArgs.kind == Oracle::Pipe)
+        {
+            unique_ptr<pipe_oracle> box;
+            try
+            {
+                box.reset(new pipe_oracle(oracleArgs.command));
+            }catch(exception& ex)
+            {
+                help(argv[0], ex.what());
+                return 5;
+            }
+
+            crackOracle(operation, trials, oracleArgs.queries, *box);
+        }
+        else
+        {
+            cout << "The cracker will give you a 12-bit block to encrypt as 3 hexadecimal digits" << endl;
+            cout << "Encrypt the block and enter the 12-bit block that results as 3 hexadecimal digits" << endl;
 
-        uint16_t key;
-        try{
-            key = cracker(box);
-            cout << "Key: " << hex << key << dec << endl;
-        }catch(exception& ex){
-            cout << "Unable to crack: " << ex.what() << endl;
+            terminal_oracle box;
+            crackOracle(operation, trials, oracleArgs.queries, box);
         }
     }
 
     return 0;
 }
 
-bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, uint64_t& trials, string& key, string& input, string& output)
+bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, uint64_t& trials, string& key, string& input, string& output, Padding& pad, unsigned& threads, oracle_args& oracleArgs)
 {
     inMode = Input::None;
     outMode = Output::None;
     op = Mode::None;
+    pad = Padding::Zeros;
+    threads = 1;
+    oracleArgs.kind = Oracle::Terminal;
+    oracleArgs.queries = 0;
+    oracleArgs.experiments = 0;
+    oracleArgs.seed = 1;
 
     for(int i=1; i<argc; i++)
     {
@@ -374,7 +828,7 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
                 return false;
             }
 
@@ -391,7 +845,7 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
                 return false;
             }
 
@@ -408,17 +862,140 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
                 return false;
             }
 
             op = Mode::Crack3;
         }
+        else if(arg == "-kp" || arg == "-kb")
+        {
+            if(op != Mode::None)
+            {
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
+                return false;
+            }
+
+            op = (arg == "-kp" ? Mode::Recover : Mode::RecoverBatch);
+
+            try{
+                if(i >= argc-1) throw logic_error("");
+                trials = stoull(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of rounds with " + arg + " [rounds]");
+                return false;
+            }
+        }
+        else if(arg == "-kq")
+        {
+            if(op != Mode::None)
+            {
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
+                return false;
+            }
+
+            op = Mode::Query;
+
+            try{
+                if(i >= argc-2) throw logic_error("");
+                trials = stoull(argv[++i]);
+                oracleArgs.queries = stoull(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of rounds and plaintexts with -kq [rounds] [plaintexts]");
+                return false;
+            }
+
+            if(oracleArgs.queries == 0 || oracleArgs.queries > BLOCKS)
+            {
+                help(argv[0], "Number of plaintexts for -kq must be between 1 and " + to_string(BLOCKS));
+                return false;
+            }
+        }
+        else if(arg == "-bm")
+        {
+            if(op != Mode::None)
+            {
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
+                return false;
+            }
+
+            op = Mode::Batch;
+        }
+        else if(arg == "-ok" || arg == "-oc")
+        {
+            if(oracleArgs.kind != Oracle::Terminal)
+            {
+                help(argv[0], "Choose at most one oracle [-ok, -oc]");
+                return false;
+            }
+
+            if(i >= argc-1)
+            {
+                help(argv[0], arg == "-ok" ? "Enter hidden key with -ok [key]" : "Enter command with -oc [command]");
+                return false;
+            }
+
+            i++;
+            if(arg == "-ok")
+            {
+                oracleArgs.kind = Oracle::Simulated;
+                oracleArgs.key = argv[i];
+            }
+            else
+            {
+                oracleArgs.kind = Oracle::Pipe;
+                oracleArgs.command = argv[i];
+            }
+        }
+        else if(arg == "-experiments")
+        {
+            try{
+                if(i >= argc-1) throw logic_error("");
+                oracleArgs.experiments = stoull(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of experiments with -experiments [n]");
+                return false;
+            }
+        }
+        else if(arg == "-p")
+        {
+            string scheme = (i < argc-1 ? argv[i+1] : "");
+            if(scheme != "zeros" && scheme != "pkcs7")
+            {
+                help(argv[0], "Choose a padding scheme with -p [zeros, pkcs7]");
+                return false;
+            }
+            pad = (scheme == "pkcs7" ? Padding::PKCS7 : Padding::Zeros);
+            i++;
+        }
+        else if(arg == "-seed")
+        {
+            try{
+                if(i >= argc-1) throw logic_error("");
+                oracleArgs.seed = stoul(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify seed with -seed [seed]");
+                return false;
+            }
+        }
+        else if(arg == "-j")
+        {
+            try{
+                if(i >= argc-1) throw logic_error("");
+                threads = stoul(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of threads with -j [threads]");
+                return false;
+            }
+
+            if(threads == 0)
+                threads = parallel::hardwareThreads();
+        }
         else if(arg == "-c4")
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
                 return false;
             }
 
@@ -447,11 +1024,11 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
 
     if(op == Mode::None)
     {
-        help(argv[0], "Choose exactly one operation [-e, -d]");
+        help(argv[0], "Choose exactly one operation [-e, -d, -c3, -c4, -kp, -kb, -kq, -bm]");
         return false;
     }
 
-    if(op == Mode::Encrypt || op == Mode::Decrypt)
+    if(op == Mode::Encrypt || op == Mode::Decrypt || op == Mode::Recover || op == Mode::RecoverBatch || op == Mode::Batch)
     {
         if(inMode == Input::None)
         {
@@ -465,6 +1042,11 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
             return false;
         }
     }
+    else if(oracleArgs.experiments && oracleArgs.kind != Oracle::Terminal)
+    {
+        help(argv[0], "Experiments make their own simulated oracles; don't use -ok or -oc with -experiments");
+        return false;
+    }
 
     return true;
 }
@@ -474,30 +1056,346 @@ void help(string name, string msg)
     cout << msg << endl;
 }
 
-string charsFromHex(string input)
+void transformUnits(const uint8_t* in, uint8_t* out, size_t size, const uint16_t* table)
 {
-    string out = "";
-    for(char& c : input) c = tolower(c);
-    if(input.find_first_not_of("0123456789abcdef") != string::npos)
-        throw logic_error("");
+    size_t full = size - size % 3;
+    for(size_t i=0; i<full; i+=3)
+    {
+        uint16_t block1 = table[(in[i] << 4) | (in[i+1] >> 4)];
+        uint16_t block2 = table[((in[i+1] & 0xF) << 8) | in[i+2]];
+
+        out[i] = block1 >> 4;
+        out[i+1] = ((block1 & 0xF) << 4) | (block2 >> 8);
+        out[i+2] = block2 & 0xFF;
+    }
 
-    if(input.size() % 2 == 1) input = input + "0";
-    for(int i=0; i<input.size(); i+=2)
+    if(full < size)
     {
-        out.push_back((input[i] >= 'a' ? input[i] - 'a' + 10 : input[i] - '0') << 4 |
-                      (input[i+1] >= 'a' ? input[i+1] - 'a' + 10 : input[i+1] - '0'));
+        uint8_t last[3] = {0, 0, 0};
+        copy(in + full, in + size, last);
+        transformUnits(last, out + full, 3, table);
     }
-    return out;
 }
 
-string hexFromChars(string input)
+bool readPairs(istream& in, vector<known_pair>& pairs)
 {
-    string out = "";
-    for(char c1 : input)
+    vector<uint16_t> blocks;
+    string token;
+    while(in >> token)
     {
-        unsigned char c = c1;
-        out.push_back((c >> 4) >= 10 ? (c >> 4) - 10 + 'a' : (c >> 4) + '0');
-        out.push_back((c & 0xF) >= 10 ? (c & 0xF) - 10 + 'a' : (c & 0xF) + '0');        
+        if(token.size() > 3 || token.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+            return false;
+        blocks.push_back(stoul(token, 0, 16));
     }
+
+    if(blocks.size() % 2)
+        return false;
+
+    for(size_t i=0; i<blocks.size(); i+=2)
+        pairs.emplace_back(blocks[i], blocks[i+1]);
+    return true;
+}
+
+string keysToString(const vector<uint16_t>& keys, const string& separator)
+{
+    string out;
+    for(size_t i=0; i<keys.size(); i++)
+        out += (i ? separator : "") + bitset<9>(keys[i]).to_string();
     return out;
+}
+
+string recoverLine(const string& line, const key_table& table)
+{
+    stringstream in(line);
+    string name;
+    if(!(in >> name) || name[0] == '#')
+        return "";
+
+    vector<known_pair> pairs;
+    if(!readPairs(in, pairs) || pairs.empty())
+        return name + " invalid\n";
+
+    vector<uint16_t> keys = table.recover(pairs.data(), pairs.size());
+    return name + " " + (keys.empty() ? "none" : keysToString(keys, ",")) + "\n";
+}
+
+void terminal_oracle::query(const uint16_t* blocks, uint16_t* out, size_t count)
+{
+    for(size_t i=0; i<count; i++)
+    {
+        char block_c[2] = {(char)(blocks[i] >> 8), (char)(blocks[i] & 0xFF)};
+        cout << "Encrypt " << hexFromChars(string((char*)block_c, 2)).substr(1) << endl << "> " << flush;
+
+        string in;
+        bool valid;
+        do
+        {
+            valid = true;
+            if(!(cin >> in))
+                throw runtime_error("No more input");
+            if(in.size() != 3 || in.find_first_not_of("0123456789abcdef") != string::npos)
+            {
+                cout << "Enter 3 hexadecimal digits" << endl << "> " << flush;
+                valid = false;
+            }
+        }while(!valid);
+
+        in = charsFromHex(in);
+        out[i] = ((in[0] << 4) & 0x0FF0) | ((in[1] >> 4) & 0x000F);
+    }
+}
+
+vector<uint16_t> attack(Mode op, uint64_t trials, uint64_t queries, oracle& box)
+{
+    if(op == Mode::Crack3)
+        return {crack3(box.box())};
+    if(op == Mode::Crack4)
+        return {crack4(box.box(), trials)};
+
+    //Any distinct plaintexts will do, so ask for the first ones all at once
+    vector<uint16_t> blocks(queries), cipher(queries);
+    for(size_t i=0; i<queries; i++)
+        blocks[i] = i;
+    box.encrypt(blocks.data(), cipher.data(), queries);
+
+    vector<known_pair> pairs;
+    for(size_t i=0; i<queries; i++)
+        pairs.emplace_back(blocks[i], cipher[i]);
+    return recoverKeys(pairs.data(), pairs.size(), trials);
+}
+
+void crackOracle(Mode op, uint64_t trials, uint64_t queries, oracle& box)
+{
+    try{
+        vector<uint16_t> keys = attack(op, trials, queries, box);
+        if(op == Mode::Query)
+        {
+            if(keys.empty())
+                cout << "No key matches every pair" << endl;
+            else
+                cout << "Key: " << keysToString(keys, "\nKey: ") << endl;
+        }
+        else
+        {
+            cout << "Key: " << hex << keys[0] << dec << endl;
+        }
+    }catch(exception& ex){
+        cout << "Unable to crack: " << ex.what() << endl;
+    }
+
+    cout << "Queries: " << box.queries() << endl;
+}
+
+void runExperiments(Mode op, uint64_t trials, const oracle_args& args, unsigned threads)
+{
+    uint16_t rounds = (op == Mode::Crack3 ? 3 : op == Mode::Crack4 ? 4 : trials);
+
+    //Keys are drawn on the calling thread, so they don't depend on the number of threads
+    mt19937 generator(args.seed);
+    uint64_t started = 0, successes = 0, queries = 0;
+
+    auto begin = chrono::steady_clock::now();
+    parallel::ordered<experiment_chunk>(threads,
+        [&](experiment_chunk& c)
+        {
+            c.keys.clear();
+            while(c.keys.size() < EXPERIMENT_CASES && started < args.experiments)
+            {
+                c.keys.push_back(generator() % KEYS);
+                started++;
+            }
+            return !c.keys.empty();
+        },
+        [&](experiment_chunk& c)
+        {
+            c.successes = c.queries = 0;
+            for(uint16_t key : c.keys)
+            {
+                simulated_oracle box(key, rounds);
+                try{
+                    vector<uint16_t> found = attack(op, trials, args.queries, box);
+                    if(found.size() == 1 && found[0] == key)
+                        c.successes++;
+                }catch(exception& ex){
+                }
+                c.queries += box.queries();
+            }
+        },
+        [&](experiment_chunk& c)
+        {
+            successes += c.successes;
+            queries += c.queries;
+        });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    cout << "Experiments: " << args.experiments << endl;
+    cout << "Successes: " << successes << " (" << fixed << setprecision(2) << 100.0 * successes / args.experiments << "%)" << endl;
+    cout << "Mean queries: " << (double)queries / args.experiments << endl;
+    cout << "Time: " << setprecision(3) << seconds << " s" << endl;
+}
+
+size_t transformTail(const uint8_t* in, uint8_t* out, size_t size, const uint16_t* table, Padding pad, bool encrypting)
+{
+    uint8_t last[3] = {0, 0, 0};
+    if(pad == Padding::Zeros || encrypting)
+    {
+        if(pad == Padding::Zeros && !size)
+            return 0;
+
+        copy(in, in + size, last);
+        if(pad == Padding::PKCS7)
+            fill(last + size, last + 3, 3 - size);
+        transformUnits(last, out, 3, table);
+        return 3;
+    }
+
+    if(size != 3)
+        throw runtime_error("PKCS#7 padded input must be a non-zero multiple of 3 bytes");
+
+    transformUnits(in, last, 3, table);
+    uint8_t n = last[2];
+    if(n < 1 || n > 3 || count(last + 3 - n, last + 3, n) != n)
+        throw runtime_error("Invalid PKCS#7 padding");
+
+    copy(last, last + 3 - n, out);
+    return 3 - n;
+}
+
+bool outputSize(Padding pad, bool encrypting, uint64_t size, uint64_t& out)
+{
+    if(pad == Padding::Zeros)
+    {
+        out = (size + 2) / 3 * 3;
+        return true;
+    }
+
+    out = size - size % 3 + 3;
+    return encrypting;
+}
+
+uint64_t transformData(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream, Output outMode, const uint16_t* table, Padding pad, bool encrypting)
+{
+    //Removing pkcs7 padding needs the whole last unit
+    size_t hold = (pad == Padding::PKCS7 && !encrypting) ? 3 : 0;
+
+    if(inMap.isOpen() && outMap.isOpen())
+    {
+        size_t full = inMap.size() - min<size_t>(inMap.size(), inMap.size() % 3 + hold);
+        transformUnits(inMap.data(), outMap.data(), full, table);
+        transformTail(inMap.data() + full, outMap.data() + full, inMap.size() - full, table, pad, encrypting);
+        return inMap.size();
+    }
+
+    vector<uint8_t> buffer(CHUNK_UNITS * 3);
+    vector<char> text(outMode == Output::File ? 0 : buffer.size() * 2);
+    size_t offset = 0, held = 0;
+    uint64_t processed = 0;
+    while(true)
+    {
+        //Read a full chunk, or whatever is left of the input, after the bytes held back from the last one
+        size_t count;
+        if(inMap.isOpen())
+        {
+            count = min(buffer.size() - held, inMap.size() - offset);
+            copy(inMap.data() + offset, inMap.data() + offset + count, buffer.begin() + held);
+            offset += count;
+        }
+        else
+        {
+            inStream->read((char*)buffer.data() + held, buffer.size() - held);
+            count = inStream->gcount();
+        }
+        processed += count;
+        count += held;
+
+        bool last = count < buffer.size();
+        held = min(count, count % 3 + hold);
+        count -= held;
+
+        transformUnits(buffer.data(), buffer.data(), count, table);
+        if(last)
+            count += transformTail(buffer.data() + count, buffer.data() + count, held, table, pad, encrypting);
+
+        if(outMode == Output::File)
+        {
+            outStream->write((char*)buffer.data(), count);
+        }
+        else
+        {
+            encode(buffer.data(), count, text.data());
+            outStream->write(text.data(), count * 2);
+        }
+
+        if(last) break;
+        copy(buffer.end() - held, buffer.end(), buffer.begin());
+    }
+
+    return processed;
+}
+
+void runFileEntry(file_entry& entry, Padding pad)
+{
+    stringstream in(entry.line);
+    string op, rounds, key, input, output;
+    in >> op >> rounds >> key >> input >> output;
+
+    entry.bytes = 0;
+    entry.ok = false;
+    bool opened = false;
+    try
+    {
+        if((op != "e" && op != "d") || output.empty() || rounds.empty() || rounds.find_first_not_of("0123456789") != string::npos)
+            throw runtime_error("Entries must be [e, d] rounds key input output");
+        if(key.find_first_not_of("01") != string::npos || key.size() != 9)
+            throw runtime_error("Key must contain exactly 9 characters from the set ['0', '1']");
+
+        uint16_t key_val = 0;
+        for(int i=0; i<9; i++)
+            key_val |= ((key[i] - '0') << 8 - i);
+
+        mapped_file inMap, outMap;
+        ifstream inFile;
+        ofstream outFile;
+        if(!inMap.openRead(input))
+        {
+            inFile.open(input, ios::binary);
+            if(!inFile)
+                throw runtime_error("Unable to open input file " + input);
+        }
+
+        if(sameFile(input, output))
+            throw runtime_error("The output file can't be the input file");
+
+        uint64_t outSize;
+        if(!(inMap.isOpen() && outputSize(pad, op == "e", inMap.size(), outSize) && outMap.openWrite(output, outSize)))
+        {
+            outFile.open(output, ios::binary | ios::trunc);
+            if(!outFile)
+                throw runtime_error("Unable to open output file " + output);
+        }
+        opened = true;
+
+        auto start = chrono::steady_clock::now();
+        codebook book(key_val, stoul(rounds));
+        entry.bytes = transformData(inMap, &inFile, outMap, &outFile, Output::File, op == "e" ? book.encryptTable() : book.decryptTable(), pad, op == "e");
+        if(outFile.is_open())
+        {
+            outFile.close();
+            if(outFile.fail())
+                throw runtime_error("Unable to write output file " + output);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        stringstream summary;
+        summary << input << " -> " << output << ": " << entry.bytes << " bytes in " << seconds << " s ("
+                << (seconds > 0 ? entry.bytes / seconds / 1e6 : 0) << " MB/s)\n";
+        entry.summary = summary.str();
+        entry.ok = true;
+    }catch(exception& ex)
+    {
+        //The files were closed as the exception left the try block
+        if(opened)
+            discardOutput(output);
+        entry.summary = (input.empty() ? entry.line : input) + ": " + ex.what() + "\n";
+    }
 }
\ No newline at end of file
@@ -8,9 +8,11 @@ The Data Encryption Standard (DES) is a symmetric-key algorithm which was used f
 security for a long time. It is now considered to be unsecure, but it was still very 
 influential in the field of electronic encryption.
 
-This specific implemention performs only the Electronic Code Book (ECB) encryption mode
-of the DES. In this mode, each block of data is encrypted/decrypted entirely indepenedently
-from the others.
+By default, this tool uses the Electronic Code Book (ECB) encryption mode of the DES. In this mode,
+each block of data is encrypted/decrypted entirely indepenedently from the others. The Cipher Block
+Chaining (CBC), Cipher Feedback (CFB), Output Feedback (OFB), and Counter (CTR) modes are also
+available; these combine each block with the one before it (or a counter) so that identical plaintext
+blocks do not produce identical ciphertext blocks. Details of the modes can be found in des64_modes.h.
 
 The DES works on blocks of 64 bits at a time, and processes them in 16 rounds of encryption.
 In each round, the block generated by the previous round is permuted, XORed, and generally mixed around
@@ -21,6 +23,12 @@ One of the important design points of the DES is that rounds can happen exactly
 encryption and decryption; the only difference is that the sub-keys are used in reverse order. This means
 that very efficient hardware could be build to do the algorithm and then used for both cases.
 
+\subsection ede_des64 Triple DES
+With the -ede option, each block is processed with three DES operations; encrypt with \f$ K_1 \f$,
+decrypt with \f$ K_2 \f$, and encrypt with \f$ K_3 \f$. If only two keys are given, \f$ K_3 = K_1 \f$. The 48 round keys
+are generated once, and the permutations between the three operations are skipped since they cancel
+each other out. Triple DES can be used with any of the modes.
+
 \section compile_des64 Compiling
 This tool can be built with the command 
 \verbatim 
@@ -41,21 +49,100 @@ tool_des64 mode input output key
 Mode Options
     - -e : To encrypt
     - -d : To decrypt
+    - -b plain cipher : To search for the key which encrypts the block 'plain' to 'cipher', written as 16 hexadecimal characters each
+    - -bm : To encrypt and decrypt the files listed in a manifest, given as the input
 
 Input Options
     - -it text : To input the text 'text'
     - -if file : To input from the file 'file'
+    - -is : To input raw binary data from stdin
 
 Output Options
     - -ot : To output to terminal
     - -of file : To output to the file 'file'
+    - -os : To output raw binary data to stdout
 
 Key Options
-    - -k key : The key to use, written as 16 hexadecimal characters
+    - -k key : The key to use, written as 16 hexadecimal characters. With -b, the known bits of the key being
+      searched for; the bits set in -km are ignored. Defaults to 0 with -b
+    - -ede keys : Use triple DES with two or three keys, written as 32 or 48 hexadecimal characters
+
+Cipher Mode Options
+    - -m mode : The mode of operation; one of ecb, cbc, cfb, ofb, ctr. Defaults to ecb
+    - -iv iv : The initialization vector for modes other than ecb, written as 16 hexadecimal characters
+
+Padding Options
+    - -p scheme : How to handle the last partial block; one of none, pkcs7, cts. Defaults to none
+
+Other Options
+    - -v : Print the number of bytes processed and the throughput (MB/s) to stderr when finished
+    - -x impl : The DES implementation to use; one of reference, sp, bitslice. Defaults to bitslice
+    - -j n : Process the input on n threads; 0 uses one thread per core. Defaults to 1, or 0 for -b and -bm
+
+Key Search Options
+    - -km mask : The unknown bits of the key, written as 16 hexadecimal characters. Defaults to every bit
+    - -kr start end : Only search the key indices from 'start' up to (not including) 'end', written in hexadecimal
+    - -cp file : Save progress to the file 'file', and resume from it if it exists
+
+With -j, the input is split into chunks which are processed on separate threads and written
+to the output in their original order; the output is identical no matter how many threads are used.
+ECB and CTR modes, as well as CBC and CFB decryption, process chunks in parallel. CBC and CFB encryption
+and OFB mode must process each block after the one before it, so chunks are processed one at a time, but
+reading and writing happen while the chunks are being processed.
+
+With -b, the tool searches for the key used to encrypt a known plaintext block (see des64_keysearch.h). Keys
+are numbered by filling the unknown bits given by -km, and -kr limits the search to a range of those numbers
+so a search can be split between machines. When every bit is unknown, the DES complementation property
+is used so that only half of the keys need to be tried, and the range covers \f$ 2^{55} \f$ numbers. The search
+uses every core unless -j is given. With -cp, the progress is saved every few seconds, and running the same
+search again continues where it left off. With -v, the number of keys tried per second is reported as the
+search runs. The key found is printed with valid parity bits, so it can be used with -k.
+
+With -bm, the input is a manifest of files to encrypt or decrypt, so a whole set of files can be processed by one run
+of the tool. Each line is one entry: the operation (e or d), the input file, the output file, the key (16 hexadecimal
+characters, or 32 or 48 for triple DES), and optionally the cipher mode and IV. File names can't contain whitespace.
+Empty lines and lines starting with # are skipped.
+\verbatim
+e reports/jan.pdf enc/jan.pdf.des 133457799bbcdff1
+e reports/feb.pdf enc/feb.pdf.des 133457799bbcdff1 cbc 0123456789abcdef
+d enc/old.des plain/old.bin 0123456789abcdeffedcba9876543210
+\endverbatim
+Each file is processed from start to finish by one thread, mapped or streamed the same way as with -if and -of,
+and -j files are processed at once. A summary line is written for each entry, in the order of the manifest, with the
+number of bytes processed, the time taken, and the throughput, or why the entry failed; a line with the totals follows.
+An entry which fails doesn't stop the others, but the tool exits with an error. Since entries are processed at
+the same time, an entry shouldn't read a file written by another entry of the same manifest.
+\verbatim
+tool_des64 -bm -if manifest.txt -of summary.txt -j 8
+\endverbatim
+
+By default, any bytes after the last full 8-byte block are dropped. With -p pkcs7, encryption pads the message to a
+multiple of 8 bytes and decryption checks and removes the padding, and with -p cts, ciphertext stealing is used so the
+output is exactly as long as the input. Either way, a message decrypts to exactly the bytes that were encrypted. Only
+the last block or two are held back and processed separately once the input ends (see des64_padding.h), so the rest of
+the message is processed in chunks as usual. If the padding is invalid, or the message is too short to steal from (less
+than 8 bytes with ECB or CBC), the tool terminates. The same padding is used for every entry of a -bm manifest.
+
+The bitslice implementation processes full batches of 64 blocks (128 or 256 when built with SSE2 or AVX2)
+at a time; any blocks left over at the end of the input are processed with the sp implementation.
 
 The key needs to pass the DES parity check; each byte should have an odd number of 1's in it.
+With -ede, each key needs to pass the parity check. Two keys \f$ K_1 K_2 \f$ encrypt as
+\f$ E_{K_1}(D_{K_2}(E_{K_1}(P))) \f$ and three keys \f$ K_1 K_2 K_3 \f$ encrypt as \f$ E_{K_3}(D_{K_2}(E_{K_1}(P))) \f$.
 When input mode is -it, it is expected that the input is a single block (64-bits) in hexadecimal
 When output mode is -ot, data will be outputted in hexadecimal
+
+When the input file is a regular file, it is memory mapped instead of read through a stream. If the output file
+is also a regular file (or does not exist yet), it is created at its final size and memory mapped as well, and data is
+transformed directly from one mapping to the other. Pipes and other special files are read and written with streams.
+
+With -is and -os, data is read from stdin and written to stdout as raw binary without any hexadecimal conversion,
+so the tool can sit in the middle of a shell pipeline:
+\verbatim
+tar c dir | tool_des64 -e -is -os -k 133457799bbcdff1 -m ctr -iv 0123456789abcdef -j 0 | zstd > dir.tar.des.zst
+\endverbatim
+Streams are read and written a chunk of CHUNK_BLOCKS blocks at a time, and only a few chunks per thread are ever
+held in memory, so memory use does not depend on the size of the input.
 */
 #include <iostream>
 #include <string>
@@ -64,26 +151,144 @@ When output mode is -ot, data will be outputted in hexadecimal
 #include <cctype>
 #include <functional>
 #include <stdexcept>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <csignal>
+#include <iomanip>
+#include <algorithm>
 
 #include "des64.h"
+#include "des64_engine.h"
+#include "des64_modes.h"
+#include "des64_keysearch.h"
+#include "des64_padding.h"
+#include "parallel.h"
+#include "mapped_file.h"
+#include "hex_codec.h"
 
 using namespace std;
-using namespace des64;
+using namespace hex_codec;
+using namespace des64_engine;
 
 //! Enums for this tool
 namespace enums_des64 {
     //! Input options
-    enum class Input{None, File, Term};
+    enum class Input{None, File, Term, Stream};
 
     //! Output options
-    enum class Output{None, File, Term};
+    enum class Output{None, File, Term, Stream};
 
     //! Mode options
-    enum class Mode{None, Encrypt, Decrypt};
+    enum class Mode{None, Encrypt, Decrypt, Search, Batch};
 }
 
 using namespace enums_des64;
 
+//! Number of 64-bit blocks read, processed, and written at a time
+const size_t CHUNK_BLOCKS = 1 << 16;
+
+//! A piece of the input which is processed independently of the rest
+struct chunk
+{
+    //! Bytes read from the input when it is a stream; replaced by the processed bytes
+    vector<unsigned char> bytes;
+
+    //! Where to read the chunk from; bytes, or the mapped input
+    const unsigned char* source;
+
+    //! Where to write the processed chunk; bytes, or the mapped output
+    unsigned char* dest;
+
+    //! The bytes as 64-bit blocks
+    vector<uint64_t> blocks;
+
+    //! Space for the cipher mode to work in
+    vector<uint64_t> scratch;
+
+    //! The processed bytes in hexadecimal, when writing to the terminal
+    vector<char> text;
+
+    //! Number of full blocks in the chunk
+    size_t count;
+
+    //! Chaining value to start this chunk with, if the mode is not chained
+    uint64_t chain;
+
+    chunk() : bytes(CHUNK_BLOCKS * 8), source(nullptr), dest(nullptr), blocks(CHUNK_BLOCKS), scratch(CHUNK_BLOCKS), count(0), chain(0) {}
+};
+
+//! One entry of a batch manifest
+struct batch_entry
+{
+    //! The manifest line
+    string line;
+
+    //! Line of the summary for the entry
+    string summary;
+
+    //! Number of bytes processed
+    uint64_t bytes;
+
+    //! Whether the entry was processed
+    bool ok;
+
+    batch_entry() : bytes(0), ok(false) {}
+};
+
+//! Number of key indices searched by one thread at a time
+const uint64_t SEARCH_UNIT = 1ULL << 22;
+
+//! Seconds between checkpoints of a key search
+const int CHECKPOINT_SECONDS = 10;
+
+//! Seconds between progress reports of a key search
+const int PROGRESS_SECONDS = 5;
+
+//! Options for a key search, as given on the command line
+struct search_args
+{
+    //! Known plaintext block
+    string plain;
+
+    //! Ciphertext block for the plaintext
+    string cipher;
+
+    //! Unknown key bits; empty if every bit is unknown
+    string mask;
+
+    //! First index to search; empty for the beginning of the key space
+    string start;
+
+    //! One past the last index to search; empty for the end of the key space
+    string end;
+
+    //! File to save progress to; empty for none
+    string checkpoint;
+};
+
+//! Set when a key search is interrupted, so it can stop and save its progress
+volatile sig_atomic_t interrupted = 0;
+
+//! A range of key indices searched by one thread
+struct search_chunk
+{
+    //! First index
+    uint64_t start;
+
+    //! One past the last index
+    uint64_t end;
+
+    //! Whether a key was found
+    bool found;
+
+    //! The key found
+    uint64_t key;
+
+    search_chunk() : start(0), end(0), found(false), key(0) {}
+};
+
 /*! Processes the command line arguments
 
 If the arguments are invalid, a usage prompt is printed with an error message
@@ -94,11 +299,19 @@ If the arguments are invalid, a usage prompt is printed with an error message
 \param[out] outMode Mode of output
 \param[out] op The operation to perform
 \param[out] key The key to use for encryption or decryption
+\param[out] ede Whether key is a set of triple DES keys
+\param[out] mode The cipher mode of operation
+\param[out] iv The initialization vector, if given
+\param[out] pad The padding scheme
 \param[out] input String to process if text mode, file name if file mode
 \param[out] output File name to output to
+\param[out] verbose Whether or not to report throughput when finished
+\param[out] impl The DES implementation to use
+\param[out] threads Number of threads to process the input with
+\param[out] search Options for a key search
 \returns bool - Whether or not the arguments were valid
 */
-bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, string& key, string& input, string& output);
+bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, string& key, bool& ede, cipher_mode& mode, string& iv, padding& pad, string& input, string& output, bool& verbose, backend& impl, unsigned& threads, search_args& search);
 
 /*! Prints the program usage prompt with an error message
 
@@ -107,76 +320,231 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
 */
 void help(string name, string msg = "");
 
-/*! Converts hexadecimal values to a string of characters. Each character is made from two hex values.
 
-\param[in] input Characters to convert
-\returns string - The ASCII output
+/*! Converts bytes to 64-bit blocks. Every 8 bytes are read as one big-endian block
+
+\param[in] bytes The bytes to convert; must hold at least 8*count bytes
+\param[out] blocks The blocks generated; must hold at least count blocks
+\param[in] count Number of blocks to generate
 */
-string charsFromHex(string input);
+void loadBlocks(const unsigned char* bytes, uint64_t* blocks, size_t count);
 
-/*! Converts characters to hexadecimal values. Each character becomes two values
+/*! Converts 64-bit blocks to bytes. Each block is written as 8 big-endian bytes
 
-\param[in] input Characters to convert
-\returns string - The hexadecimal output
+\param[in] blocks The blocks to convert
+\param[out] bytes The bytes generated; must hold at least 8*count bytes
+\param[in] count Number of blocks to convert
 */
-string hexFromChars(string input);
+void storeBlocks(const uint64_t* blocks, unsigned char* bytes, size_t count);
+
+/*! Converts up to 16 hexadecimal characters to a 64-bit value
+
+\param[in] text The characters to convert
+\param[out] value The value
+\returns bool - Whether or not text was valid
+*/
+bool valueFromHex(const string& text, uint64_t& value);
+
+/*! Encrypts or decrypts everything from an input to an output
+
+Data is read in chunks of CHUNK_BLOCKS blocks, converted to 64-bit blocks all at once, processed, and written back
+with a single write. Mapped input is converted straight out of the mapping, and mapped output is written in place.
+Up to the requested number of threads process chunks at once, and chunks are written in the order they were read.
+In modes where each block depends on the previous one, chunks are processed one at a time, each starting from the
+chaining value left by the one before it. The last partial block, along with the last full block if the padding
+needs it (see heldBlocks), is held back from the chunks and processed with processTail once the input ends; with no
+padding, the trailing bytes are dropped.
+
+\param[in] inMap The mapped input, if it is mapped
+\param[in] inStream The input, if it is not mapped
+\param[in] outMap The mapped output, if it is mapped; it must be the size given by outputSize
+\param[in] outStream The output, if it is not mapped
+\param[in] outMode Mode of output; the terminal is written in hexadecimal
+\param[in] encrypting Whether to encrypt or decrypt
+\param[in] mode The cipher mode of operation
+\param[in] iv The initialization vector
+\param[in] pad The padding scheme
+\param[in] impl The DES implementation to use
+\param[in] schedule The key schedule
+\param[in] threads Number of threads to process the input with
+\returns uint64_t - Number of bytes written
+\throws ios_base::failure - If the output stream can't be written, such as a full disk or a closed pipe
+\throws runtime_error - If the padding is invalid or the input is too short for it
+*/
+uint64_t transformData(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream, Output outMode, bool encrypting, cipher_mode mode, uint64_t iv, padding pad, backend impl, const key_schedule& schedule, unsigned threads);
+
+/*! Searches for the key which encrypts a known plaintext block to its ciphertext
+
+The key space is split into units of SEARCH_UNIT indices which are searched on the requested number of threads.
+Units finish in order, so everything before the last finished unit has been searched; that point is saved
+to the checkpoint file every CHECKPOINT_SECONDS seconds and when the search ends. If the search is interrupted
+with SIGINT or SIGTERM, the units already started are finished and the progress is saved before exiting. If the
+checkpoint file already exists, the search resumes from it.
+
+\param[in] name Name of the program
+\param[in] args The search options
+\param[in] key Key holding the known bits; empty if none are known
+\param[in] outMode Mode of output
+\param[in] output File name to output to
+\param[in] verbose Whether or not to report progress while searching
+\param[in] threads Number of threads to search with
+\returns int - The exit code for the program
+*/
+int searchKey(const string& name, const search_args& args, const string& key, Output outMode, const string& output, bool verbose, unsigned threads);
+
+/*! Runs one entry of a batch manifest on the calling thread
+
+An entry is a line of the form "operation input output key [mode iv]", where operation is e or d, key is 16
+hexadecimal characters or 32 or 48 for triple DES, and mode defaults to ecb. The files are opened the same way
+as -if and -of, and the key is checked the same way as -k and -ede.
+
+\param[in,out] entry The entry; its summary, bytes, and ok are filled in
+\param[in] pad The padding scheme
+\param[in] impl The DES implementation to use
+*/
+void runBatchEntry(batch_entry& entry, padding pad, backend impl);
+
+/*! Runs every entry of a batch manifest
+
+Entries are read from the manifest and handed to the threads, each of which processes its entry from start to
+finish on its own, so up to the requested number of files are processed at once. The summary of each entry
+is written in the order of the manifest, followed by the totals. Empty lines and lines starting with # are skipped.
+
+\param[in] name Name of the program
+\param[in] inMode Mode of input for the manifest; a file or stdin
+\param[in] manifest File name of the manifest
+\param[in] outMode Mode of output for the summary
+\param[in] output File name to output the summary to
+\param[in] pad The padding scheme for every entry
+\param[in] impl The DES implementation to use
+\param[in] threads Number of files to process at once
+\returns int - The exit code for the program
+*/
+int runBatch(const string& name, Input inMode, const string& manifest, Output outMode, const string& output, padding pad, backend impl, unsigned threads);
 
 /*!
     Processes the command line arguments. If they are invalid, the application terminates. 
 
     The key is converted from hex to a 64-bit value. If it is not 16 hex values long,
-    the application terminates.
+    the application terminates. For triple DES, the keys are converted the same way and must be
+    32 or 48 hex values long.
+
+    If a mode other than ECB is used, the IV is converted from hex to a 64-bit value. If it is
+    missing or not 16 hex values long, the application terminates.
+
+    The key schedule is generated once. If the key parity fails, the application terminates.
 
-    Any files that will be used are opened. If text is used as the input, it is copied
-    into an input stream. If a file fails to open, the application terminates.
+    Any files that will be used are opened; regular files are memory mapped, and anything else is
+    opened as a stream. If text is used as the input, it is copied into an input stream. If stdin or stdout
+    are used, they are unsynchronized from C stdio so that whole chunks go straight to read and write. If a
+    file fails to open, the application terminates.
 
-    Data is processed 8 bytes at a time (16 if reading hexadecimal) and written to
-    the output in the same format. If the key parity fails, the application terminates.
-    If 8 bytes are not available, 0's are appended
+    The data is then transformed chunk by chunk (see transformData). Hexadecimal output is encoded by the
+    thread that processed the chunk.
+
+    In search mode, nothing is read; the key search is run instead (see searchKey). In batch mode, each
+    entry of the manifest is run on its own (see runBatch).
 
     \param[in] argc Number of command line arguments
     \param[in] argv The command line arguments
     \returns 0 - The program ran successfully
     \returns 1 - The command line arguments were invalid
     \returns 2 - A file could not be opened
-    \returns 3 - The key was the wrong size
+    \returns 3 - The key or keys were the wrong size
     \returns 4 - The input was supposed to be hexadecmal, but was not valid
     \returns 5 - The key parity check failed
+    \returns 7 - The IV was missing or the wrong size
+    \returns 8 - The checkpoint file is for a different search
+    \returns 9 - The key search was interrupted before it finished
+    \returns 10 - An entry of the batch manifest failed
+    \returns 11 - The padding was invalid, or the input was too short for it
+    \returns 12 - The output could not be written
 */
 int main(int argc, char** argv)
 {
-    string key, input, output;
+    string key, iv, input, output;
     Input inputMode;
     Output outputMode;
     Mode operation;
+    bool ede;
+    cipher_mode mode;
+    padding pad;
+    bool verbose;
+    backend impl;
+    unsigned threads;
+    search_args search;
 
     stringstream inText;
 
     ifstream inFile;
     ofstream outFile;
 
+    mapped_file inMap;
+    mapped_file outMap;
+
     istream* inStream = &inText;
     ostream* outStream = &cout;
 
-    if(!processArgs(argc, argv, inputMode, outputMode, operation, key, input, output))
+    if(!processArgs(argc, argv, inputMode, outputMode, operation, key, ede, mode, iv, pad, input, output, verbose, impl, threads, search))
     {
         return 1;
     }
 
-    uint64_t key_val = 0;
+    if(operation == Mode::Search)
+    {
+        return searchKey(argv[0], search, key, outputMode, output, verbose, threads);
+    }
+    else if(operation == Mode::Batch)
+    {
+        return runBatch(argv[0], inputMode, input, outputMode, output, pad, impl, threads);
+    }
+
+    vector<uint64_t> key_vals;
     try
     {
-        if(key.size() != 16)
+        size_t count = ede ? key.size() / 16 : 1;
+        if(key.size() != 16 * count || (ede && count != 2 && count != 3))
             throw logic_error("");
-        
-        key_val = stoull(key, 0, 16);
+
+        for(size_t i=0; i<count; i++)
+            key_vals.push_back(stoull(key.substr(16*i, 16), 0, 16));
     }catch(exception& ex)
     {
-        help(argv[0], "Key must contain exactly 16 hexadecimal characters [0-9, a-f]");
+        help(argv[0], ede ? "Triple DES keys must contain exactly 32 or 48 hexadecimal characters [0-9, a-f]" :
+                            "Key must contain exactly 16 hexadecimal characters [0-9, a-f]");
         return 3;
     }
 
-    if(inputMode == Input::File)
+    uint64_t iv_val = 0;
+    if(mode != cipher_mode::ECB)
+    {
+        try
+        {
+            if(iv.size() != 16)
+                throw logic_error("");
+
+            iv_val = stoull(iv, 0, 16);
+        }catch(exception& ex)
+        {
+            help(argv[0], "IV must contain exactly 16 hexadecimal characters [0-9, a-f]");
+            return 7;
+        }
+    }
+
+    unique_ptr<key_schedule> schedule;
+    try
+    {
+        if(ede)
+            schedule.reset(new key_schedule(key_vals[0], key_vals[1], key_vals[key_vals.size() == 3 ? 2 : 0]));
+        else
+            schedule.reset(new key_schedule(key_vals[0]));
+    }catch(exception& ex)
+    {
+        cerr << "Key parity fails" << endl;
+        return 5;
+    }
+
+    if(inputMode == Input::File && !inMap.openRead(input))
     {
         inFile.open(input, ios::binary);
         if(!inFile)
@@ -187,7 +555,11 @@ int main(int argc, char** argv)
 
         inStream = &inFile;
     }
-    else
+    else if(inputMode == Input::Stream)
+    {
+        inStream = &cin;
+    }
+    else if(inputMode != Input::File)
     {
         try
         {
@@ -199,7 +571,17 @@ int main(int argc, char** argv)
         }
     }
 
-    if(outputMode == Output::File)
+    if(inputMode == Input::File && outputMode == Output::File && sameFile(input, output))
+    {
+        help(argv[0], "The output file can't be the input file");
+        inFile.close();
+        return 2;
+    }
+
+    //The output size is known if the input is mapped, unless it depends on the padding in the last block
+    uint64_t outSize;
+    if(outputMode == Output::File && !(inMap.isOpen() && outputSize(pad, operation == Mode::Encrypt, inMap.size(), outSize)
+                                       && outMap.openWrite(output, outSize)))
     {
         outFile.open(output, ios::binary | ios::trunc);
         if(!outFile)
@@ -212,88 +594,138 @@ int main(int argc, char** argv)
         outStream = &outFile;
     }
 
-    function<uint64_t(uint64_t, const uint64_t&)> op = (operation == Mode::Encrypt ? encrypt : decrypt);
+    if(inputMode == Input::Stream || outputMode == Output::Stream)
+    {
+        ios::sync_with_stdio(false);
+        cin.tie(nullptr);
+    }
 
-    uint64_t block;
-    bool done = false;
-    while(*inStream)
+    auto start = chrono::steady_clock::now();
+    uint64_t processed;
+    int failed = 0;
+    try
     {
-        block = 0;
-        for(int i=0; i<8 && *inStream; i++)
-        {
-            unsigned char byte;
-            inStream->read((char*)&byte, 1);
+        processed = transformData(inMap, inStream, outMap, outStream, outputMode, operation == Mode::Encrypt, mode, iv_val, pad, impl, *schedule, threads);
+    }catch(ios_base::failure& ex)
+    {
+        cerr << "Unable to write the output" << endl;
+        failed = 12;
+    }catch(runtime_error& ex)
+    {
+        cerr << ex.what() << endl;
+        failed = 11;
+    }
 
-            if(!*inStream)
-            {
-                done = true;
-            }
-            else
-            {
-                block |= ((uint64_t)byte << ((7-i) * 8));
-            }
-        }
-        if(done) break;
+    if(failed)
+    {
+        //Don't leave a partly written or zero-filled output behind
+        outMap.close();
+        outFile.close();
+        if(outputMode == Output::File)
+            discardOutput(output);
+        return failed;
+    }
+    auto end = chrono::steady_clock::now();
 
-        try
-        {
-            block = op(block, key_val);
-        }catch(exception)
-        {
-            cerr << "Key parity fails" << endl;
-            inFile.close();
-            outFile.close();
-            return 5;
-        }
-        
-        unsigned char block_chars[8];
-        for(int i=0; i<8; i++)
-        {
-            block_chars[7-i] = (block & 0xFF);
-            block >>= 8;
-        }
+    //A write error is only certain to show once the output has been flushed or closed
+    bool written = true;
+    if(outFile.is_open())
+    {
+        outFile.close();
+        written = !outFile.fail();
+    }
+    else if(outputMode != Output::File)
+    {
+        cout.flush();
+        written = !cout.fail();
+    }
 
+    if(!written)
+    {
+        cerr << "Unable to write the output" << endl;
         if(outputMode == Output::File)
-        {
-            outStream->write((char*)block_chars, 8);
-        }
-        else
-        {
-            *outStream << hexFromChars(string((char*)block_chars, 8));
-        }
+            discardOutput(output);
+        return 12;
+    }
+
+    if(verbose)
+    {
+        double seconds = chrono::duration<double>(end - start).count();
+        cerr << "Processed " << processed << " bytes in " << seconds << " s ("
+             << (seconds > 0 ? processed / seconds / 1e6 : 0) << " MB/s)" << endl;
     }
 
     inFile.close();
-    outFile.close();
 
     return 0;
 }
 
-bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, string& key, string& input, string& output)
+bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op, string& key, bool& ede, cipher_mode& mode, string& iv, padding& pad, string& input, string& output, bool& verbose, backend& impl, unsigned& threads, search_args& search)
 {
     inMode = Input::None;
     outMode = Output::None;
     op = Mode::None;
+    ede = false;
+    mode = cipher_mode::ECB;
+    pad = padding::None;
+    verbose = false;
+    impl = DEFAULT_BACKEND;
+    threads = 0;
 
     for(int i=1; i<argc; i++)
     {
         string arg = argv[i];
 
-        if(arg == "-k")
+        if(arg == "-k" || arg == "-ede")
         {
+            if(key.size())
+            {
+                help(argv[0], "Choose exactly one key option [-k, -ede]");
+                return false;
+            }
+
             if(i >= argc-1)
             {
-                help(argv[0], "Enter key with -k [key]");
+                help(argv[0], arg == "-k" ? "Enter key with -k [key]" : "Enter keys with -ede [keys]");
                 return false;
             }
             i++;
             key = argv[i];
+            ede = (arg == "-ede");
+        }
+        else if(arg == "-m")
+        {
+            if(i >= argc-1 || !modeFromName(argv[i+1], mode))
+            {
+                help(argv[0], "Choose a mode with -m [ecb, cbc, cfb, ofb, ctr]");
+                return false;
+            }
+            i++;
+        }
+        else if(arg == "-p")
+        {
+            if(i >= argc-1 || !paddingFromName(argv[i+1], pad))
+            {
+                help(argv[0], "Choose a padding scheme with -p [none, pkcs7, cts]");
+                return false;
+            }
+            i++;
+        }
+        else if(arg == "-iv")
+        {
+            if(i >= argc-1)
+            {
+                help(argv[0], "Enter IV with -iv [iv]");
+                return false;
+            }
+            i++;
+            iv = argv[i];
         }
         else if(arg == "-it")
         {
             if(inMode != Input::None)
             {
-                help(argv[0], "Choose exactly one input mode [-it, -if]");
+                help(argv[0], "Choose exactly one input mode [-it, -if, -is]");
                 return false;
             }
 
@@ -312,7 +744,7 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(inMode != Input::None)
             {
-                help(argv[0], "Choose exactly one input mode [-it, -if]");
+                help(argv[0], "Choose exactly one input mode [-it, -if, -is]");
                 return false;
             }
 
@@ -327,21 +759,41 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
             i++;
             input = argv[i];
         }
+        else if(arg == "-is")
+        {
+            if(inMode != Input::None)
+            {
+                help(argv[0], "Choose exactly one input mode [-it, -if, -is]");
+                return false;
+            }
+
+            inMode = Input::Stream;
+        }
         else if(arg == "-ot")
         {
             if(outMode != Output::None)
             {
-                help(argv[0], "Choose exactly one output mode [-ot, -of]");
+                help(argv[0], "Choose exactly one output mode [-ot, -of, -os]");
                 return false;
             }
 
             outMode = Output::Term;
         }
+        else if(arg == "-os")
+        {
+            if(outMode != Output::None)
+            {
+                help(argv[0], "Choose exactly one output mode [-ot, -of, -os]");
+                return false;
+            }
+
+            outMode = Output::Stream;
+        }
         else if(arg == "-of")
         {
             if(outMode != Output::None)
             {
-                help(argv[0], "Choose exactly one output mode [-ot, -of]");
+                help(argv[0], "Choose exactly one output mode [-ot, -of, -os]");
                 return false;
             }
 
@@ -360,7 +812,7 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -b, -bm]");
                 return false;
             }
 
@@ -370,12 +822,95 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
         {
             if(op != Mode::None)
             {
-                help(argv[0], "Choose exactly one operation [-e, -d]");
+                help(argv[0], "Choose exactly one operation [-e, -d, -b, -bm]");
                 return false;
             }
 
             op = Mode::Decrypt;
         }
+        else if(arg == "-b")
+        {
+            if(op != Mode::None)
+            {
+                help(argv[0], "Choose exactly one operation [-e, -d, -b, -bm]");
+                return false;
+            }
+
+            op = Mode::Search;
+
+            if(i >= argc-2)
+            {
+                help(argv[0], "Enter the known blocks with -b [plaintext] [ciphertext]");
+                return false;
+            }
+
+            search.plain = argv[++i];
+            search.cipher = argv[++i];
+        }
+        else if(arg == "-bm")
+        {
+            if(op != Mode::None)
+            {
+                help(argv[0], "Choose exactly one operation [-e, -d, -b, -bm]");
+                return false;
+            }
+
+            op = Mode::Batch;
+        }
+        else if(arg == "-km")
+        {
+            if(i >= argc-1)
+            {
+                help(argv[0], "Enter the unknown key bits with -km [mask]");
+                return false;
+            }
+            search.mask = argv[++i];
+        }
+        else if(arg == "-kr")
+        {
+            if(i >= argc-2)
+            {
+                help(argv[0], "Enter the range of key indices with -kr [start] [end]");
+                return false;
+            }
+            search.start = argv[++i];
+            search.end = argv[++i];
+        }
+        else if(arg == "-cp")
+        {
+            if(i >= argc-1)
+            {
+                help(argv[0], "Enter checkpoint file name with -cp {file}");
+                return false;
+            }
+            search.checkpoint = argv[++i];
+        }
+        else if(arg == "-v")
+        {
+            verbose = true;
+        }
+        else if(arg == "-x")
+        {
+            if(i >= argc-1 || !backendFromName(argv[i+1], impl))
+            {
+                help(argv[0], "Choose an implementation with -x [reference, sp, bitslice]");
+                return false;
+            }
+            i++;
+        }
+        else if(arg == "-j")
+        {
+            try{
+                if(i >= argc-1) throw logic_error("");
+                threads = stoul(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of threads with -j [threads]");
+                return false;
+            }
+
+            if(threads == 0)
+                threads = parallel::hardwareThreads();
+        }
         else
         {
             help(argv[0], "Unknown option: " + arg);
@@ -385,19 +920,56 @@ bool processArgs(int argc, char** argv, Input& inMode, Output& outMode, Mode& op
 
     if(op == Mode::None)
     {
-        help(argv[0], "Choose exactly one operation [-e, -d]");
+        help(argv[0], "Choose exactly one operation [-e, -d, -b, -bm]");
         return false;
     }
 
+    //Searches use every core unless told otherwise, and only print the key they find
+    if(op == Mode::Search)
+    {
+        if(!threads)
+            threads = parallel::hardwareThreads();
+
+        if(ede || inMode != Input::None || (outMode != Output::None && outMode != Output::Term && outMode != Output::File))
+        {
+            help(argv[0], "A key search takes no input, and outputs to the terminal or a file [-ot, -of]");
+            return false;
+        }
+        if(outMode == Output::None)
+            outMode = Output::Term;
+
+        return true;
+    }
+
+    //Batches process a file per core unless told otherwise, and write a summary
+    if(op == Mode::Batch)
+    {
+        if(!threads)
+            threads = parallel::hardwareThreads();
+
+        if(key.size() || (inMode != Input::File && inMode != Input::Stream) || outMode == Output::Stream)
+        {
+            help(argv[0], "A batch reads its manifest from a file or stdin [-if, -is], takes its keys from the manifest, and outputs to the terminal or a file [-ot, -of]");
+            return false;
+        }
+        if(outMode == Output::None)
+            outMode = Output::Term;
+
+        return true;
+    }
+
+    if(!threads)
+        threads = 1;
+
     if(inMode == Input::None)
     {
-        help(argv[0], "Choose exactly one input mode [-it, -if]");
+        help(argv[0], "Choose exactly one input mode [-it, -if, -is]");
         return false;
     }
 
     if(outMode == Output::None)
     {
-        help(argv[0], "Choose exactly one output mode [-ot, -of]");
+        help(argv[0], "Choose exactly one output mode [-ot, -of, -os]");
         return false;
     }
 
@@ -412,48 +984,494 @@ void help(string name, string msg)
 Mode Options\n\
     -e : To encrypt\n\
     -d : To decrypt\n\
+    -b plain cipher : To search for the key which encrypts the block 'plain' to 'cipher', written as 16 hexadecimal characters each\n\
+    -bm : To encrypt and decrypt the files listed in a manifest, given as the input\n\
     \n\
 Input Options\n\
     -it text : To input the text 'text'\n\
     -if file : To input from the file 'file'\n\
+    -is : To input raw binary data from stdin\n\
     \n\
 Output Options\n\
     -ot : To output to terminal\n\
     -of file : To output to the file 'file'\n\
+    -os : To output raw binary data to stdout\n\
     \n\
 Key Options\n\
-    -k key : The key to use, written as 16 hexadecimal characters\n\
+    -k key : The key to use, written as 16 hexadecimal characters. With -b, the known bits of the key being\n\
+             searched for; the bits set in -km are ignored. Defaults to 0 with -b\n\
+    -ede keys : Use triple DES with two or three keys, written as 32 or 48 hexadecimal characters\n\
+    \n\
+Cipher Mode Options\n\
+    -m mode : The mode of operation; one of ecb, cbc, cfb, ofb, ctr. Defaults to ecb\n\
+    -iv iv : The initialization vector for modes other than ecb, written as 16 hexadecimal characters\n\
+    \n\
+Padding Options\n\
+    -p scheme : How to handle the last partial block; one of none, pkcs7, cts. Defaults to none\n\
+    \n\
+Other Options\n\
+    -v : Print the number of bytes processed and the throughput (MB/s) to stderr when finished\n\
+    -x impl : The DES implementation to use; one of reference, sp, bitslice. Defaults to bitslice\n\
+    -j n : Process the input on n threads; 0 uses one thread per core. Defaults to 1, or 0 for -b and -bm\n\
+    \n\
+Key Search Options\n\
+    -km mask : The unknown bits of the key, written as 16 hexadecimal characters. Defaults to every bit\n\
+    -kr start end : Only search the key indices from 'start' up to (not including) 'end', written in hexadecimal\n\
+    -cp file : Save progress to the file 'file', and resume from it if it exists\n\
     \n\
 The key needs to pass the DES parity check; each byte should have an odd number of 1's in it.\n\
+With -ede, each key needs to pass the parity check. Two keys K1 K2 are used as K1 K2 K1.\n\
 When input mode is -it, it is expected that the input is a single block (64-bits) in hexadecimal\n\
 When output mode is -ot, data will be outputted in hexadecimal" << endl;
 }
 
-string charsFromHex(string input)
+void loadBlocks(const unsigned char* bytes, uint64_t* blocks, size_t count)
 {
-    string out = "";
-    for(char& c : input) c = tolower(c);
-    if(input.find_first_not_of("0123456789abcdef") != string::npos)
-        throw logic_error("");
+    for(size_t i=0; i<count; i++, bytes += 8)
+    {
+        blocks[i] = ((uint64_t)bytes[0] << 56) | ((uint64_t)bytes[1] << 48) |
+                    ((uint64_t)bytes[2] << 40) | ((uint64_t)bytes[3] << 32) |
+                    ((uint64_t)bytes[4] << 24) | ((uint64_t)bytes[5] << 16) |
+                    ((uint64_t)bytes[6] << 8)  |  (uint64_t)bytes[7];
+    }
+}
 
-    if(input.size() % 2 == 1) input = input + "0";
-    for(int i=0; i<input.size(); i+=2)
+void storeBlocks(const uint64_t* blocks, unsigned char* bytes, size_t count)
+{
+    for(size_t i=0; i<count; i++, bytes += 8)
     {
-        out.push_back((input[i] >= 'a' ? input[i] - 'a' + 10 : input[i] - '0') << 4 |
-                      (input[i+1] >= 'a' ? input[i+1] - 'a' + 10 : input[i+1] - '0'));
+        uint64_t block = blocks[i];
+        for(int j=7; j>=0; j--)
+        {
+            bytes[j] = (block & 0xFF);
+            block >>= 8;
+        }
     }
+}
 
-    return out;
+bool valueFromHex(const string& text, uint64_t& value)
+{
+    if(text.empty() || text.size() > 16 || text.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+        return false;
+
+    value = stoull(text, 0, 16);
+    return true;
 }
 
-string hexFromChars(string input)
+uint64_t transformData(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream, Output outMode, bool encrypting, cipher_mode mode, uint64_t iv, padding pad, backend impl, const key_schedule& schedule, unsigned threads)
 {
-    string out = "";
-    for(char c1 : input)
+    bool chained = isChained(mode, encrypting);
+    uint64_t chain = iv;
+    uint64_t processed = 0;
+
+    //The bytes held back for processTail; a stream carries them over to the front of the next chunk until it ends
+    uint64_t hold = heldBlocks(pad, mode, encrypting) * 8;
+    vector<unsigned char> tail;
+
+    parallel::ordered<chunk>(threads,
+        [&](chunk& c)
+        {
+            //Read a full chunk, or whatever is left of the input other than the tail
+            if(inMap.isOpen())
+            {
+                uint64_t left = inMap.size() - processed;
+                c.count = min<uint64_t>(CHUNK_BLOCKS, (left - min(left, left % 8 + hold)) / 8);
+                c.source = inMap.data() + processed;
+                if(!c.count) tail.assign(c.source, c.source + left);
+            }
+            else
+            {
+                if(!*inStream) return false;
+                copy(tail.begin(), tail.end(), c.bytes.begin());
+                inStream->read((char*)c.bytes.data() + tail.size(), c.bytes.size() - tail.size());
+
+                uint64_t have = tail.size() + inStream->gcount();
+                c.count = (have - min(have, have % 8 + hold)) / 8;
+                c.source = c.bytes.data();
+                tail.assign(c.source + c.count * 8, c.source + have);
+            }
+            if(!c.count) return false;
+
+            c.dest = (outMap.isOpen() ? outMap.data() + processed : c.bytes.data());
+            processed += c.count * 8;
+
+            //Hand out chaining values now so chunks can be processed in any order
+            if(!chained)
+            {
+                uint64_t last;
+                loadBlocks(c.source + 8*(c.count-1), &last, 1);
+                c.chain = chain;
+                chain = nextChain(mode, last, c.count, chain);
+            }
+            return true;
+        },
+        [&](chunk& c)
+        {
+            loadBlocks(c.source, c.blocks.data(), c.count);
+            if(chained)
+                chain = processChunk(mode, encrypting, impl, schedule, c.blocks.data(), c.count, chain, c.scratch.data());
+            else
+                processChunk(mode, encrypting, impl, schedule, c.blocks.data(), c.count, c.chain, c.scratch.data());
+            storeBlocks(c.blocks.data(), c.dest, c.count);
+
+            if(outMode == Output::Term)
+            {
+                c.text.resize(c.count * 16);
+                encode(c.dest, c.count * 8, c.text.data());
+            }
+        },
+        [&](chunk& c)
+        {
+            //Mapped output was written in place by the worker
+            if(outMap.isOpen())
+                return;
+
+            if(outMode == Output::File || outMode == Output::Stream)
+            {
+                outStream->write((char*)c.dest, c.count * 8);
+            }
+            else
+            {
+                outStream->write(c.text.data(), c.count * 16);
+            }
+
+            //Stop at the first failed write rather than processing the rest of the input for nothing
+            if(!*outStream)
+                throw ios_base::failure("Unable to write the output");
+        }, chained);
+
+    //Every chunk is done, so chain is left from the last block before the tail
+    unsigned char last[MAX_TAIL];
+    size_t size = processTail(pad, mode, encrypting, impl, schedule, tail.data(), tail.size(), chain, last);
+    if(outMap.isOpen())
+    {
+        copy(last, last + size, outMap.data() + processed);
+    }
+    else if(outMode == Output::File || outMode == Output::Stream)
+    {
+        outStream->write((char*)last, size);
+    }
+    else
+    {
+        char text[MAX_TAIL * 2];
+        encode(last, size, text);
+        outStream->write(text, size * 2);
+    }
+    outStream->flush();
+    if(!*outStream)
+        throw ios_base::failure("Unable to write the output");
+
+    return processed + size;
+}
+
+int searchKey(const string& name, const search_args& args, const string& key, Output outMode, const string& output, bool verbose, unsigned threads)
+{
+    uint64_t plain, cipher, base = 0, mask = ~0ULL;
+    if(args.plain.size() != 16 || args.cipher.size() != 16 || !valueFromHex(args.plain, plain) || !valueFromHex(args.cipher, cipher))
+    {
+        help(name, "Known blocks must contain exactly 16 hexadecimal characters [0-9, a-f]");
+        return 4;
+    }
+
+    if(key.size() && (key.size() != 16 || !valueFromHex(key, base)))
+    {
+        help(name, "Key must contain exactly 16 hexadecimal characters [0-9, a-f]");
+        return 3;
+    }
+
+    if(args.mask.size() && (args.mask.size() != 16 || !valueFromHex(args.mask, mask)))
+    {
+        help(name, "Key mask must contain exactly 16 hexadecimal characters [0-9, a-f]");
+        return 4;
+    }
+
+    key_space space(base, mask);
+    uint64_t start = 0, end = space.size();
+    if(args.start.size() && (!valueFromHex(args.start, start) || !valueFromHex(args.end, end) || start >= end || end > space.size()))
     {
-        unsigned char c = c1;
-        out.push_back((c >> 4) >= 10 ? (c >> 4) - 10 + 'a' : (c >> 4) + '0');
-        out.push_back((c & 0xF) >= 10 ? (c & 0xF) - 10 + 'a' : (c & 0xF) + '0');        
+        stringstream msg;
+        msg << "Key index range must be hexadecimal values with start < end <= " << hex << space.size();
+        help(name, msg.str());
+        return 4;
     }
-    return out;
-}
\ No newline at end of file
+
+    //Resume from the checkpoint if there is one; it must be for the same search
+    uint64_t next = start;
+    stringstream id;
+    id << hex << "des64-search " << plain << " " << cipher << " " << space.base() << " " << space.mask() << " " << start << " " << end;
+    if(args.checkpoint.size())
+    {
+        ifstream in(args.checkpoint);
+        string line;
+        if(in && getline(in, line))
+        {
+            size_t split = line.rfind(' ');
+            if(split == string::npos || line.substr(0, split) != id.str() || !valueFromHex(line.substr(split + 1), next) || next < start || next > end)
+            {
+                cerr << "Checkpoint " << args.checkpoint << " is for a different search" << endl;
+                return 8;
+            }
+        }
+    }
+
+    //Saves the progress, replacing the old checkpoint only once the new one is written
+    auto save = [&](uint64_t done)
+    {
+        if(args.checkpoint.empty()) return true;
+
+        string temp = args.checkpoint + ".tmp";
+        ofstream out(temp, ios::trunc);
+        out << id.str() << " " << hex << done << endl;
+        out.close();
+        return out && !rename(temp.c_str(), args.checkpoint.c_str());
+    };
+
+    if(!save(next))
+    {
+        help(name, "Unable to write checkpoint file " + args.checkpoint);
+        return 2;
+    }
+
+    ofstream outFile;
+    ostream* outStream = &cout;
+    if(outMode == Output::File)
+    {
+        outFile.open(output, ios::trunc);
+        if(!outFile)
+        {
+            help(name, "Unable to open output file " + output);
+            return 2;
+        }
+
+        outStream = &outFile;
+    }
+
+    uint64_t perIndex = (space.complemented() ? 2 : 1);
+    if(verbose)
+    {
+        cerr << "Searching " << (end - next) * perIndex << " keys on " << threads << " threads"
+             << (space.complemented() ? " using the complementation property" : "") << endl;
+    }
+
+    signal(SIGINT, [](int){ interrupted = 1; });
+    signal(SIGTERM, [](int){ interrupted = 1; });
+
+    bool found = false;
+    uint64_t result = 0, resumed = next;
+    auto begin = chrono::steady_clock::now();
+    auto lastSave = begin, lastReport = begin;
+    parallel::ordered<search_chunk>(threads,
+        [&](search_chunk& c)
+        {
+            if(found || interrupted || next >= end) return false;
+
+            c.start = next;
+            c.end = next = min(end, next + SEARCH_UNIT);
+            return true;
+        },
+        [&](search_chunk& c)
+        {
+            c.found = space.search(plain, cipher, c.start, c.end, c.key);
+        },
+        [&](search_chunk& c)
+        {
+            //A candidate is only reported if the des64 library agrees that it encrypts the block
+            if(c.found && !found && des64::encrypt(plain, c.key) == cipher)
+            {
+                found = true;
+                result = c.key;
+            }
+
+            auto now = chrono::steady_clock::now();
+            if(found || now - lastSave >= chrono::seconds(CHECKPOINT_SECONDS))
+            {
+                save(c.end);
+                lastSave = now;
+            }
+
+            if(verbose && now - lastReport >= chrono::seconds(PROGRESS_SECONDS))
+            {
+                double seconds = chrono::duration<double>(now - begin).count();
+                cerr << "Searched " << (c.end - start) * perIndex << " of " << (end - start) * perIndex << " keys ("
+                     << 100.0 * (c.end - start) / (end - start) << "%), "
+                     << (c.end - resumed) * perIndex / seconds << " keys/s" << endl;
+                lastReport = now;
+            }
+        });
+    auto finish = chrono::steady_clock::now();
+
+    //Everything handed out was searched, so the whole range up to next is done
+    save(next);
+
+    if(verbose)
+    {
+        double seconds = chrono::duration<double>(finish - begin).count();
+        cerr << "Searched " << (next - resumed) * perIndex << " keys in " << seconds << " s ("
+             << (seconds > 0 ? (next - resumed) * perIndex / seconds : 0) << " keys/s)" << endl;
+    }
+
+    if(!found && interrupted)
+    {
+        cerr << "Search interrupted; run it again with the same options to continue" << endl;
+        return 9;
+    }
+
+    if(found)
+        *outStream << "Key: " << hex << setw(16) << setfill('0') << result << dec << endl;
+    else
+        *outStream << "Key not found" << endl;
+
+    outFile.close();
+
+    return 0;
+}
+
+void runBatchEntry(batch_entry& entry, padding pad, backend impl)
+{
+    stringstream in(entry.line);
+    string op, input, output, key, modeName = "ecb", iv;
+    in >> op >> input >> output >> key >> modeName >> iv;
+
+    entry.bytes = 0;
+    entry.ok = false;
+    bool opened = false;
+    try
+    {
+        cipher_mode mode;
+        if((op != "e" && op != "d") || key.empty())
+            throw runtime_error("Entries must be [e, d] input output key [mode iv]");
+        if(!modeFromName(modeName, mode))
+            throw runtime_error("Unknown mode " + modeName);
+
+        vector<uint64_t> key_vals(key.size() / 16);
+        if(key.size() % 16 || key_vals.empty() || key_vals.size() > 3)
+            throw runtime_error("Key must contain 16, 32, or 48 hexadecimal characters");
+        for(size_t i=0; i<key_vals.size(); i++)
+            if(!valueFromHex(key.substr(16*i, 16), key_vals[i]))
+                throw runtime_error("Key must contain 16, 32, or 48 hexadecimal characters");
+
+        uint64_t iv_val = 0;
+        if(mode != cipher_mode::ECB && (iv.size() != 16 || !valueFromHex(iv, iv_val)))
+            throw runtime_error("IV must contain exactly 16 hexadecimal characters");
+
+        unique_ptr<key_schedule> schedule;
+        try
+        {
+            if(key_vals.size() == 1)
+                schedule.reset(new key_schedule(key_vals[0]));
+            else
+                schedule.reset(new key_schedule(key_vals[0], key_vals[1], key_vals[key_vals.size() == 3 ? 2 : 0]));
+        }catch(exception& ex)
+        {
+            throw runtime_error("Key parity fails");
+        }
+
+        mapped_file inMap, outMap;
+        ifstream inFile;
+        ofstream outFile;
+        if(!inMap.openRead(input))
+        {
+            inFile.open(input, ios::binary);
+            if(!inFile)
+                throw runtime_error("Unable to open input file " + input);
+        }
+
+        if(sameFile(input, output))
+            throw runtime_error("The output file can't be the input file");
+
+        uint64_t outSize;
+        if(!(inMap.isOpen() && outputSize(pad, op == "e", inMap.size(), outSize) && outMap.openWrite(output, outSize)))
+        {
+            outFile.open(output, ios::binary | ios::trunc);
+            if(!outFile)
+                throw runtime_error("Unable to open output file " + output);
+        }
+        opened = true;
+
+        auto start = chrono::steady_clock::now();
+        entry.bytes = transformData(inMap, &inFile, outMap, &outFile, Output::File, op == "e", mode, iv_val, pad, impl, *schedule, 1);
+        if(outFile.is_open())
+        {
+            outFile.close();
+            if(outFile.fail())
+                throw runtime_error("Unable to write output file " + output);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        stringstream summary;
+        summary << input << " -> " << output << ": " << entry.bytes << " bytes in " << seconds << " s ("
+                << (seconds > 0 ? entry.bytes / seconds / 1e6 : 0) << " MB/s)\n";
+        entry.summary = summary.str();
+        entry.ok = true;
+    }catch(exception& ex)
+    {
+        //The files were closed as the exception left the try block
+        if(opened)
+            discardOutput(output);
+        entry.summary = (input.empty() ? entry.line : input) + ": " + ex.what() + "\n";
+    }
+}
+
+int runBatch(const string& name, Input inMode, const string& manifest, Output outMode, const string& output, padding pad, backend impl, unsigned threads)
+{
+    ifstream inFile;
+    ofstream outFile;
+    istream* inStream = &cin;
+    ostream* outStream = &cout;
+
+    if(inMode == Input::File)
+    {
+        inFile.open(manifest);
+        if(!inFile)
+        {
+            help(name, "Unable to open input file " + manifest);
+            return 2;
+        }
+
+        inStream = &inFile;
+    }
+
+    if(outMode == Output::File)
+    {
+        outFile.open(output, ios::trunc);
+        if(!outFile)
+        {
+            help(name, "Unable to open output file " + output);
+            return 2;
+        }
+
+        outStream = &outFile;
+    }
+
+    uint64_t entries = 0, failed = 0, bytes = 0;
+
+    auto start = chrono::steady_clock::now();
+    parallel::ordered<batch_entry>(threads,
+        [&](batch_entry& e)
+        {
+            while(getline(*inStream, e.line))
+            {
+                size_t first = e.line.find_first_not_of(" \t\r");
+                if(first != string::npos && e.line[first] != '#')
+                    return true;
+            }
+            return false;
+        },
+        [&](batch_entry& e)
+        {
+            runBatchEntry(e, pad, impl);
+        },
+        [&](batch_entry& e)
+        {
+            entries++;
+            failed += !e.ok;
+            bytes += e.bytes;
+            *outStream << e.summary << flush;
+        });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    *outStream << "Total: " << entries << " files (" << failed << " failed), " << bytes << " bytes in " << seconds
+               << " s (" << (seconds > 0 ? bytes / seconds / 1e6 : 0) << " MB/s)" << endl;
+
+    return failed ? 10 : 0;
+}
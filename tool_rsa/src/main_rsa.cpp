@@ -32,6 +32,19 @@ As stated above, the encryption exponent \f$ e \f$ and \f$ n \f$ make up the pub
 and \f$ n \f$. It seems pretty obvious that the private key, \f$ p \f$, and \f$ q \f$ should be kept private; however, it is less obvious that \f$ \phi(n) \f$
 should also remain private. This is because knowing \f$ \phi(n) \f$ is enough information to factor \f$ n \f$. Once that is done, \f$ d \f$ can be found.
 
+\subsection crt_rsa Chinese Remainder Theorem
+Decryption can be made several times faster by keeping \f$ p \f$ and \f$ q \f$ with the private key. Since \f$ n = pq \f$, the
+Chinese Remainder Theorem says \f$ m \f$ mod \f$ n \f$ is determined by \f$ m \f$ mod \f$ p \f$ and \f$ m \f$ mod \f$ q \f$, each of which can
+be found with an exponentiation half the size of \f$ n \f$. By Fermat's Little Theorem, the exponents can also be reduced to
+\f$ d_P = d \f$ mod \f$ (p-1) \f$ and \f$ d_Q = d \f$ mod \f$ (q-1) \f$. With \f$ q_{inv} = q^{-1} \f$ mod \f$ p \f$ computed once,
+    - \f$ m_1 = c^{d_P} \f$ mod \f$ p \f$
+    - \f$ m_2 = c^{d_Q} \f$ mod \f$ q \f$
+    - \f$ h = q_{inv}(m_1 - m_2) \f$ mod \f$ p \f$
+    - \f$ m = m_2 + hq \f$
+
+Exponentiation costs about the cube of the number of bits, so each half-size exponentiation costs about an eighth of the
+full one, and the pair of them about a quarter.
+
 Another less obvious note is that the messages encrypted using this method should not be Much Smaller than \f$ n \f$. If they are, then
 the cipher value is weak against a Low Exponent Attack, and may be decrypted by brute force.
 
@@ -48,6 +61,16 @@ of bytes into a large number. The number of bytes is determined to be the floor
 by using successive powers of 256 to encrypt bytes, we can get a message close to \f$ n \f$ which can be decomposed back into the
 original string.
 
+The sum of powers of 256 is just the bytes read as a big-endian number, which is how GMP stores numbers internally, so the bytes
+are converted with mpz_import and mpz_export (see rsa_engine.h) rather than by multiplying and dividing one byte at a time.
+
+A block of that many bytes can still be as large as \f$ n \f$ when the top byte of \f$ n \f$ is 0xFF, so the binary container
+uses one byte less per block, which always fits. Its last block is filled out with 0 bytes, and the header records the length
+of the input so decryption writes back exactly the input. Hexadecimal ciphertext keeps the full block size; its last block
+is filled out with 0xFF bytes, and when the input is a multiple of the block size a block of only 0xFF bytes is added, so
+its decrypted output is always followed by some 0xFF bytes and then a block of 0 bytes. A block which would not be less
+than \f$ n \f$ stops hexadecimal encryption with an error.
+
 \section compile_rsa Compiling
 This tool can be built with the command 
 \verbatim 
@@ -66,7 +89,7 @@ This tool can be used to generate public and private key pairs, as well as encry
 
 \verbatim
 tool_rsa -g public private bits
-tool_rsa -e/-d input output key
+tool_rsa -e/-d input output key [-f format] [-j n]
 \endverbatim
 Mode Options
     - -g : To generate a public, private key pair. 
@@ -83,9 +106,45 @@ Output Options
 Key Options
     - The key should be the file name of the key to use.
 
+Format Options
+    - -f binary : Encrypt to a binary container. Default
+    - -f hex : Encrypt to hexadecimal text, with each block separated by a space
+    - -f hybrid : Encrypt a random session key with RSA, and the input with the session key
+
+Decryption recognizes every format, so -f only affects encryption.
+
+Other Options
+    - -j n : Encrypt or decrypt on n threads; 0 uses one thread per core. Defaults to 1
+
+Every block is an independent modular exponentiation, so with -j the blocks are read in chunks of RSA_CHUNK_BLOCKS
+and the chunks are processed on separate threads, then written in their original order; the output is identical no
+matter how many threads are used. Each thread keeps its own GMP values for the intermediate results, so blocks are
+processed without allocating.
+
+The binary container (see rsa_container.h) holds every block at a fixed width after a short header with the key's
+fingerprint, so it is half the size of the hexadecimal text and needs no parsing. When the container and the output
+are regular files, they are mapped into memory and each thread decrypts its blocks straight from the container to
+their place in the output. A container made with a different key is refused instead of being decrypted to garbage.
+Binary output needs to know the number of blocks before the first one is written, so the input must be a file whose
+size can be found; use -f hex to encrypt from a pipe.
+
+\subsection hybrid_rsa Hybrid Encryption
+Encrypting every block with RSA limits the tool to a few hundred kilobytes per second, which is far too slow for large
+files. With -f hybrid, a random session key is made for the file and only it is encrypted with RSA; the file itself is
+encrypted with triple DES in CTR mode using the session key (see rsa_hybrid.h), so the throughput is that of the
+block cipher rather than of the modular exponentiation. The output is a session container: the header, the wrapped
+session key, and then the encrypted file, which is exactly as long as the input. Like the other containers, it is
+processed in chunks on up to -j threads, straight between mapped files when the input and output are regular files.
+The input may also be a pipe, since the size of the encrypted file doesn't need to be known in advance.
+
 Keys should generally be larger than 2048 bits for security; 3072 bits if they will be used through the year 2030.
 Picking a number of bits less than 8 will fail because n must be at least 256
 The key file for encryption should be a public key, and for decryption should the matching private key.
+
+Key files hold each value in hexadecimal, separated by whitespace. A public key is \f$ e \f$ then \f$ n \f$. A private key is
+\f$ d \f$ then \f$ n \f$, followed by \f$ p, q, d_P, d_Q, q_{inv} \f$ so that it can be decrypted with the Chinese Remainder Theorem.
+Private keys with only \f$ d \f$ and \f$ n \f$, like the ones written by older versions of this tool, can still be used;
+they are decrypted with a full-size exponentiation.
 */
 
 #include <iostream>
@@ -98,28 +157,83 @@ The key file for encryption should be a public key, and for decryption should th
 #include <stdexcept>
 #include <random>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 #include <gmpxx.h>
 #include <functional>
 
 #include "cryptomath.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "rsa_container.h"
+#include "rsa_engine.h"
+#include "rsa_hybrid.h"
+#include "des64_keyschedule.h"
 
 using namespace std;
+using namespace rsa_engine;
 
 //! Enums for this tool
 namespace enums_rsa {
     //! Mode options
     enum class Mode{None, Encrypt, Decrypt, Generate};
+    //! Ciphertext formats
+    enum class Format{Binary, Hex, Hybrid};
 }
 
 using namespace enums_rsa;
 
-//! Container for some \f$ n \f$ and either \f$ e \f$ or \f$ d \f$
-struct rsa_key
+//! Number of blocks read, processed, and written at a time
+const size_t RSA_CHUNK_BLOCKS = 32;
+
+//! A chunk of blocks to encrypt or decrypt
+struct rsa_chunk
 {
-    //! The modulus n
-    mpz_class n;
-    //! Either the encryption or decryption exponent
-    mpz_class de;
+    //! For encryption, the bytes of each block. For a container read from a stream, the encrypted blocks
+    vector<unsigned char> bytes;
+    //! For decryption, each block as it was written in hexadecimal
+    vector<string> words;
+    //! Number of blocks in the chunk
+    size_t count;
+    //! For a container, the number of message bytes the chunk decrypts to; the last block's fill is left out
+    size_t size;
+    //! For a container, the encrypted blocks
+    const unsigned char* source;
+    //! For a container, where to write the decrypted blocks
+    unsigned char* dest;
+    //! The block being processed
+    mpz_class block;
+    //! Scratch values for the thread processing the chunk
+    rsa_scratch scratch;
+    //! The output of the chunk
+    string out;
+
+    rsa_chunk() : count(0), size(0), source(nullptr), dest(nullptr) {}
+};
+
+//! Number of 8-byte blocks of a session container's data read, processed, and written at a time
+const size_t SESSION_CHUNK_BLOCKS = 1 << 16;
+
+//! A chunk of the data of a session container
+struct session_chunk
+{
+    //! The input, if it isn't mapped; processed in place
+    vector<unsigned char> bytes;
+    //! The input as DES blocks
+    vector<uint64_t> blocks;
+    //! Space for the key stream
+    vector<uint64_t> scratch;
+    //! The input of the chunk
+    const unsigned char* source;
+    //! Where to write the output of the chunk
+    unsigned char* dest;
+    //! Number of bytes in the chunk
+    size_t size;
+    //! The CTR counter for the first block of the chunk
+    uint64_t counter;
+
+    session_chunk() : bytes(SESSION_CHUNK_BLOCKS * 8), blocks(SESSION_CHUNK_BLOCKS), scratch(SESSION_CHUNK_BLOCKS),
+                      source(nullptr), dest(nullptr), size(0), counter(0) {}
 };
 
 /*! Processes the command line arguments
@@ -133,9 +247,11 @@ If the arguments are invalid, a usage prompt is printed with an error message
 \param[out] file2 The second file parameter
 \param[out] file3 The third file parameter for encryption or decryptino
 \param[out] bits The number of bits to use if generating a key
+\param[out] format The format to encrypt to
+\param[out] threads Number of threads to encrypt or decrypt with
 \returns bool - Whether or not the arguments were valid
 */
-bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2, string& file3, uint64_t& bits);
+bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2, string& file3, uint64_t& bits, Format& format, unsigned& threads);
 
 /*! Prints the program usage prompt with an error message
 
@@ -144,30 +260,21 @@ bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2,
 */
 void help(string name, string msg = "");
 
-/*! Generates an RSA public, private key pair.
-
-    \f$ e \f$ is chosen to be 65537, and then random \f$ p, q \f$ are generated with bits/2 bits
-    until \f$ gcd(p, e) = gcd(q, e) = 1 \f$. At that point, \f$ n \f$ and \f$ d \f$ can be calculated.
-
-    \param[in] bits Number of bits in \f$ n \f$
-    \param[out] out the public, private pair generated
-*/
-void generateKey(const uint64_t& bits, pair<rsa_key, rsa_key>& out);
-
 /*! Loads a generated key from an input stream
 
     The key is assumed to be first either \f$ e \f$ or \f$ d \f$, then whitespace, then \f$ n \f$,
-    written in hexadecimal.
+    written in hexadecimal. If a private key is followed by \f$ p, q, d_P, d_Q, q_{inv} \f$, they are read as well.
 
     \param[in,out] in The stream to read from
     \param[out] key The key read
+    \throws runtime_error : The key is incomplete, or its CRT values don't match \f$ n \f$ and \f$ d \f$
 */
 void loadKey(istream& in, rsa_key& key);
 
 /*! Saves a generated key to an output stream
 
     The key is saved in the form of either \f$ e \f$ or \f$ d \f$, then whitespace, then \f$ n \f$,
-    written in hexadecimal.
+    written in hexadecimal, followed by \f$ p, q, d_P, d_Q, q_{inv} \f$ if the key has them.
 
     \param[in,out] out The stream to write to
     \param[in] key The key to write
@@ -176,26 +283,97 @@ void saveKey(ostream& out, rsa_key& key);
 
 /*! Encrypts all data in a stream and writes it to an output stream
 
+    Blocks are read on the calling thread, and packed and encrypted on up to the given number of threads.
+
     \param[in,out] in The stream to read
     \param[in,out] out The stream to write
     \param[in] publick The public key to encrypt with
+    \param[in] format The format to write
+    \param[in] threads Number of threads to encrypt with
+    \throws runtime_error : Binary output was asked for, but the size of the input can't be found
 */
-void encrypt(istream& in, ostream& out, const rsa_key& publick);
+void encrypt(istream& in, ostream& out, const rsa_key& publick, Format format, unsigned threads);
 
 /*! Decrypts all data in a stream and writes it to an output stream
 
+    Blocks are read on the calling thread, and parsed, decrypted, and unpacked on up to the given number of threads.
+
     \param[in,out] in The stream to read
     \param[in,out] out The stream to write
     \param[in] privatek The private key to decrypt with
+    \param[in] threads Number of threads to decrypt with
+    \throws runtime_error : A block is not a hexadecimal number
 */
-void decrypt(istream& in, ostream& out, const rsa_key& privatek);
+void decrypt(istream& in, ostream& out, const rsa_key& privatek, unsigned threads);
 
-/*! Calculates the number of bytes to use to build a single message \f$ m \f$
+/*! Checks a container's header before anything is decrypted from it
 
-    \param[in] n The value \f$ n \f$ that the message should be smaller than
-    uint64_t - The number of bytes that can be used to build a message \f$ m \f$
+    \param[in] inMap The mapped container, if it could be mapped
+    \param[in] header The container's header, already checked against the key
+    \throws runtime_error : The number of blocks doesn't match the length, or the mapped container ends before its last block
+*/
+void checkContainer(const mapped_file& inMap, const container_header& header);
+
+/*! Decrypts the blocks of a container whose header has already been read
+
+    Each chunk is a range of blocks. If the container is mapped, the blocks are decrypted straight from it;
+    otherwise they are read from the stream on the calling thread. If the output is mapped, each block is
+    written to its offset in it by the thread that decrypted it; otherwise chunks are written to the stream in order.
+
+    \param[in] inMap The mapped container, if it could be mapped
+    \param[in,out] inStream The stream to read, positioned after the header, if the container isn't mapped
+    \param[in] outMap The mapped output, if it could be mapped
+    \param[in,out] outStream The stream to write, if the output isn't mapped
+    \param[in] header The container's header
+    \param[in] privatek The private key to decrypt with
+    \param[in] threads Number of threads to decrypt with
+    \throws runtime_error : The header is invalid, the container ends early, or a block is not less than n
+*/
+void decryptContainer(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream,
+                      const container_header& header, const rsa_key& privatek, unsigned threads);
+
+/*! Encrypts all data with a new session key, and writes a session container
+
+    \param[in] inMap The mapped input, if it could be mapped
+    \param[in,out] inStream The stream to read, if the input isn't mapped
+    \param[in] outMap The mapped output, if it could be mapped; sized for the header, wrapped key, and input
+    \param[in,out] outStream The stream to write, if the output isn't mapped
+    \param[in] publick The public key to wrap the session key with
+    \param[in] threads Number of threads to encrypt with
+    \throws runtime_error : The key is too small to wrap a session key
 */
-uint64_t blockSize(const mpz_class& n);
+void encryptSession(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream,
+                    const rsa_key& publick, unsigned threads);
+
+/*! Reads and unwraps the session key of a session container whose header has already been read
+
+    This is done before the output is opened, so a damaged wrapped key leaves no output behind.
+
+    \param[in] inMap The mapped container, if it could be mapped
+    \param[in,out] inStream The stream to read, positioned after the header, if the container isn't mapped;
+                            left positioned at the encrypted data
+    \param[in] header The container's header
+    \param[in] privatek The private key to unwrap the session key with
+    \returns session_key - The session key, with its parity checked
+    \throws runtime_error : The container has no wrapped session key, or it can't be unwrapped
+*/
+session_key loadSession(const mapped_file& inMap, istream* inStream, const container_header& header, const rsa_key& privatek);
+
+/*! Runs the data of a session container through the session's key stream, in chunks on multiple threads
+
+    Encryption and decryption are the same operation in CTR mode.
+
+    \param[in] inMap The mapped input, if it could be mapped
+    \param[in] inStart Offset of the data in the mapped input
+    \param[in,out] inStream The stream to read, positioned at the data, if the input isn't mapped
+    \param[in] outMap The mapped output, if it could be mapped
+    \param[in] outStart Offset of the data in the mapped output
+    \param[in,out] outStream The stream to write, if the output isn't mapped
+    \param[in] session The session key
+    \param[in] threads Number of threads to use
+*/
+void streamSession(const mapped_file& inMap, size_t inStart, istream* inStream, const mapped_file& outMap, size_t outStart,
+                   ostream* outStream, const session_key& session, unsigned threads);
 
 /*!
     Processes the command line arguments. If they are invalid, the application terminates. 
@@ -210,16 +388,19 @@ uint64_t blockSize(const mpz_class& n);
     \returns 1 - The command line arguments were invalid
     \returns 2 - A file could not be opened
     \returns 3 - An error occurred while reading a key file
-    \returns 4 - An error occurred while processing an input file
+    \returns 4 - An error occurred while processing an input file or writing the output
     \returns 5 - An error occurred while generating a key pair
+    \returns 6 - The ciphertext was encrypted with a different key
 */
 int main(int argc, char** argv)
 {
     string file1, file2, file3;
     uint64_t bits;
+    unsigned threads;
     Mode operation;
+    Format format;
 
-    if(!processArgs(argc, argv, operation, file1, file2, file3, bits))
+    if(!processArgs(argc, argv, operation, file1, file2, file3, bits, format, threads))
     {
         return 1;
     }
@@ -243,11 +424,14 @@ int main(int argc, char** argv)
 
         try{
             cout << "Generating keys..." << endl;
-            pair<rsa_key, rsa_key> keys;
-            generateKey(bits, keys);
+            auto t = chrono::system_clock::now();
+            mt19937_64 reng(chrono::duration_cast<chrono::milliseconds>(t.time_since_epoch()).count());
+
+            rsa_key publick, privatek;
+            generateKey(bits, reng, publick, privatek);
             cout << "Saving keys..." << endl;
-            saveKey(pub, keys.first);
-            saveKey(priv, keys.second);
+            saveKey(pub, publick);
+            saveKey(priv, privatek);
         }catch(exception& ex){
             cerr << "Unable to generate public/private pair: " << ex.what() << endl;
             pub.close();
@@ -260,19 +444,17 @@ int main(int argc, char** argv)
     }
     else
     {
-        ifstream fin(file1);
-        if(!fin)
+        //Containers and hybrid input are mapped if they can be, so they can be processed by offset
+        mapped_file inMap, outMap;
+        ifstream fin;
+        if(!((operation == Mode::Decrypt || format == Format::Hybrid) && inMap.openRead(file1)))
         {
-            cerr << "Unable to open input file " << file1 << endl;
-            return 2;
-        }
-
-        ofstream fout(file2);
-        if(!fout)
-        {
-            cerr << "Unable to open output file " << file2 << endl;
-            fin.close();
-            return 2;
+            fin.open(file1, ios::binary);
+            if(!fin)
+            {
+                cerr << "Unable to open input file " << file1 << endl;
+                return 2;
+            }
         }
 
         ifstream keyFile(file3);
@@ -280,7 +462,6 @@ int main(int argc, char** argv)
         {
             cerr << "Unable to open key file " << file3 << endl;
             fin.close();
-            fout.close();
             return 2;
         }
 
@@ -291,151 +472,448 @@ int main(int argc, char** argv)
         }catch(exception& ex){
             cerr << "Unable to load key: " << ex.what() << endl;
             fin.close();
-            fout.close();
             keyFile.close();
             return 3;
         }
+        keyFile.close();
+
+        //Hexadecimal text can't start with the first byte of the magic value
+        bool container = false;
+        container_header header;
+        session_key session;
+        if(operation == Mode::Decrypt)
+        {
+            try{
+                if(inMap.isOpen())
+                {
+                    container = inMap.data()[0] == CONTAINER_MAGIC[0];
+                    if(container)
+                        loadHeader(inMap.data(), inMap.size(), header);
+                }
+                else if(fin.peek() == CONTAINER_MAGIC[0])
+                {
+                    container = true;
+                    unsigned char bytes[HEADER_SIZE];
+                    fin.read((char*)bytes, HEADER_SIZE);
+                    loadHeader(bytes, fin.gcount(), header);
+                }
+            }catch(exception& ex){
+                cerr << "Error during processing: " << ex.what() << endl;
+                fin.close();
+                return 4;
+            }
+
+            if(container && !matchesKey(header, k))
+            {
+                cerr << "The input was encrypted with a different key" << endl;
+                fin.close();
+                return 6;
+            }
+
+            //The output is sized from the header, so a bad one is caught before the output is made
+            try{
+                if(container && header.kind == container_kind::Blocks)
+                    checkContainer(inMap, header);
+                else if(container)
+                    session = loadSession(inMap, &fin, header, k);
+            }catch(exception& ex){
+                cerr << "Error during processing: " << ex.what() << endl;
+                fin.close();
+                return 4;
+            }
+
+            if(!container && inMap.isOpen())
+            {
+                inMap.close();
+                fin.open(file1, ios::binary);
+                if(!fin)
+                {
+                    cerr << "Unable to open input file " << file1 << endl;
+                    return 2;
+                }
+            }
+        }
+
+        if(sameFile(file1, file2))
+        {
+            cerr << "The output file can't be the input file" << endl;
+            fin.close();
+            return 2;
+        }
+
+        //The output size is known up front for a mapped container, and for hybrid encryption of a mapped input
+        uint64_t outSize = 0;
+        if(container && header.kind == container_kind::Blocks && inMap.isOpen())
+            outSize = header.length;
+        else if(container && inMap.isOpen())
+            outSize = inMap.size() - min<uint64_t>(inMap.size(), HEADER_SIZE + header.width);
+        else if(operation == Mode::Encrypt && format == Format::Hybrid && inMap.isOpen())
+            outSize = HEADER_SIZE + modulusBytes(k.n) + inMap.size();
+
+        ofstream fout;
+        if(!(outSize && outMap.openWrite(file2, outSize)))
+        {
+            fout.open(file2, ios::binary | ios::trunc);
+            if(!fout)
+            {
+                cerr << "Unable to open output file " << file2 << endl;
+                fin.close();
+                return 2;
+            }
+        }
 
         try{
             cout << "Processing file..." << endl;
-            if(operation == Mode::Encrypt)
+            if(operation == Mode::Encrypt && format == Format::Hybrid)
+            {
+                encryptSession(inMap, &fin, outMap, &fout, k, threads);
+            }
+            else if(operation == Mode::Encrypt)
             {
-                encrypt(fin, fout, k);
+                encrypt(fin, fout, k, format, threads);
+            }
+            else if(container && header.kind == container_kind::Session)
+            {
+                streamSession(inMap, HEADER_SIZE + header.width, &fin, outMap, 0, &fout, session, threads);
+            }
+            else if(container)
+            {
+                decryptContainer(inMap, &fin, outMap, &fout, header, k, threads);
             }
             else
             {
-                decrypt(fin, fout, k);
+                decrypt(fin, fout, k, threads);
             }
         }catch(exception& ex){
             cerr << "Error during processing: " << ex.what() << endl;
             fin.close();
+
+            //Don't leave a partly written or zero-filled output behind
             fout.close();
-            keyFile.close();
+            outMap.close();
+            discardOutput(file2);
             return 4;
         }
 
         fin.close();
-        fout.close();
-        keyFile.close();
+        if(fout.is_open())
+        {
+            fout.close();
+            if(fout.fail())
+            {
+                cerr << "Unable to write output file " << file2 << endl;
+                discardOutput(file2);
+                return 4;
+            }
+        }
     }
 
     return 0;
 }
 
-/*!
-    \throws logic_error : n is smaller than 256
-*/
-void generateKey(const uint64_t& bits, pair<rsa_key, rsa_key>& out)
+void loadKey(istream& in, rsa_key& key)
 {
-    auto t = std::chrono::system_clock::now();
-    mt19937_64 reng(chrono::duration_cast<chrono::milliseconds>(t.time_since_epoch()).count());
+    if(!(in >> hex >> key.de >> key.n))
+        throw runtime_error("Key files must start with the exponent and n");
+
+    //Keys from before the CRT values were kept end here
+    in >> key.p;
+    if(in.fail() && in.eof())
+        return;
+
+    if(!(in >> key.q >> key.dP >> key.dQ >> key.qInv))
+        throw runtime_error("Private keys must have all of p, q, dP, dQ, qInv or none of them");
+    if(key.p <= 1 || key.q <= 1 || key.p * key.q != key.n || cryptomath::mod<mpz_class>(key.q * key.qInv, key.p) != 1)
+        throw runtime_error("The CRT values do not match n");
+    if(key.dP != cryptomath::mod<mpz_class>(key.de, key.p - 1) || key.dQ != cryptomath::mod<mpz_class>(key.de, key.q - 1))
+        throw runtime_error("The CRT values do not match d");
+
+    key.crt = true;
+}
 
-    //Choose e to be 65537
-    out.first.de = 65537;
+void saveKey(ostream& out, rsa_key& key)
+{
+    out << hex << key.de << endl << key.n << endl;
+    if(key.crt)
+        out << key.p << endl << key.q << endl << key.dP << endl << key.dQ << endl << key.qInv << endl;
+}
 
-    //Pick p until p % e is not 1
-    mpz_class p;
-    do
-    {
-        p = cryptomath::randomPrime<mpz_class, mt19937_64>(reng, bits/2);
-    }while(cryptomath::mod<mpz_class>(p, out.first.de) == 1);
+void encrypt(istream& in, ostream& out, const rsa_key& publick, Format format, unsigned threads)
+{
+    //A container's blocks are one byte narrower than n, so they are always less than it
+    uint64_t chars = (format == Format::Binary ? messageBytes(publick.n) : blockSize(publick.n));
+    size_t width = modulusBytes(publick.n);
 
-    //Pick q until q % e is not 1
-    mpz_class q; 
-    do
+    //The container records the length, so the last block only needs filling out. Hexadecimal text
+    //ends with a partial block, which may be empty, filled with 0xFF
+    if(format == Format::Binary)
     {
-        q = cryptomath::randomPrime<mpz_class, mt19937_64>(reng, bits-bits/2);
-    }while(cryptomath::mod<mpz_class>(q, out.first.de) == 1);
+        in.seekg(0, ios::end);
+        streamoff size = in.tellg();
+        in.seekg(0, ios::beg);
+        if(size < 0 || !in)
+            throw runtime_error("Binary output needs an input whose size can be found; use -f hex");
+
+        unsigned char header[HEADER_SIZE];
+        storeHeader(makeHeader(publick, size / chars + (size % chars != 0), size), header);
+        out.write((char*)header, HEADER_SIZE);
+    }
 
-    //Calculate n
-    out.first.n = out.second.n = p * q;
+    parallel::ordered<rsa_chunk>(threads,
+        [&](rsa_chunk& c)
+        {
+            if(!in) return false;
+
+            c.bytes.resize(RSA_CHUNK_BLOCKS * chars);
+            in.read((char*)c.bytes.data(), c.bytes.size());
+            size_t got = in.gcount();
+            if(got == c.bytes.size())
+            {
+                c.count = RSA_CHUNK_BLOCKS;
+                return true;
+            }
 
-    if(out.first.n < 256)
-        throw std::logic_error("n less than 256, use more bits");
+            if(format == Format::Binary)
+            {
+                c.count = got / chars + (got % chars != 0);
+                fill(c.bytes.begin() + got, c.bytes.begin() + c.count * chars, 0);
+                return c.count != 0;
+            }
 
-    //Calculate phi(n)
-    mpz_class phi = (p - 1) * (q - 1);
+            c.count = got / chars + 1;
+            fill(c.bytes.begin() + got, c.bytes.begin() + c.count * chars, 0xFF);
+            return true;
+        },
+        [&](rsa_chunk& c)
+        {
+            if(format == Format::Binary)
+                c.out.resize(c.count * width);
+            else
+                c.out.clear();
 
-    //Calculate d
-    out.second.de = cryptomath::inverseMod<mpz_class>(out.first.de, phi);
+            for(size_t b=0; b<c.count; b++)
+            {
+                //A block of blockSize() bytes can still reach n when the top byte of n is 0xFF
+                packBlock(c.bytes.data() + b * chars, chars, c.block);
+                if(c.block >= publick.n)
+                    throw runtime_error("A block is not less than n; encrypt with -f binary");
+
+                encryptBlock(c.block, publick);
+                if(format == Format::Binary)
+                    unpackBlock(c.block, (unsigned char*)&c.out[b * width], width);
+                else
+                    c.out += c.block.get_str(16) + " ";
+            }
+        },
+        [&](rsa_chunk& c)
+        {
+            out << c.out;
+        });
 }
 
-void loadKey(istream& in, rsa_key& key)
+void decrypt(istream& in, ostream& out, const rsa_key& privatek, unsigned threads)
 {
-    in >> hex >> key.de >> key.n;
+    uint64_t chars = blockSize(privatek.n);
+    parallel::ordered<rsa_chunk>(threads,
+        [&](rsa_chunk& c)
+        {
+            if(!in) return false;
+
+            //A block that can't be read, at the end of the file, is left empty and decrypts as 0
+            c.words.resize(RSA_CHUNK_BLOCKS);
+            for(c.count = 0; c.count < RSA_CHUNK_BLOCKS && in; c.count++)
+            {
+                c.words[c.count].clear();
+                in >> c.words[c.count];
+            }
+            return true;
+        },
+        [&](rsa_chunk& c)
+        {
+            c.out.resize(c.count * chars);
+            for(size_t b=0; b<c.count; b++)
+            {
+                c.block = 0;
+                if(c.words[b].size() && c.block.set_str(c.words[b], 16))
+                    throw runtime_error(c.words[b] + " is not a hexadecimal block");
+
+                decryptBlock(c.block, privatek, c.scratch);
+                unpackBlock(c.block, (unsigned char*)&c.out[b * chars], chars);
+            }
+        },
+        [&](rsa_chunk& c)
+        {
+            out << c.out;
+        });
 }
 
-void saveKey(ostream& out, rsa_key& key)
+void checkContainer(const mapped_file& inMap, const container_header& header)
 {
-    out << hex << key.de << endl << key.n << endl;
+    uint64_t chars = header.width - 1;
+    if(header.blocks != header.length / chars + (header.length % chars != 0))
+        throw runtime_error("The container's number of blocks does not match its length");
+    if(inMap.isOpen() && (inMap.size() - HEADER_SIZE) / header.width < header.blocks)
+        throw runtime_error("The container ends before its last block");
 }
 
-uint64_t blockSize(const mpz_class& n)
+void decryptContainer(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream,
+                      const container_header& header, const rsa_key& privatek, unsigned threads)
 {
-    mpz_class a = 1;
-    uint64_t p = 0;
+    uint64_t chars = messageBytes(privatek.n);
+    size_t width = header.width;
+    checkContainer(inMap, header);
+
+    //The last block may be only partly message, and the rest of it is left out
+    vector<unsigned char> last(chars);
+    uint64_t next = 0;
+    parallel::ordered<rsa_chunk>(threads,
+        [&](rsa_chunk& c)
+        {
+            c.count = min<uint64_t>(RSA_CHUNK_BLOCKS, header.blocks - next);
+            if(!c.count) return false;
 
-    while(a*255 < n)
-    {
-        a = a*256;
-        p++;
-    }
+            if(inMap.isOpen())
+            {
+                c.source = inMap.data() + HEADER_SIZE + next * width;
+            }
+            else
+            {
+                c.bytes.resize(c.count * width);
+                inStream->read((char*)c.bytes.data(), c.bytes.size());
+                if((size_t)inStream->gcount() != c.bytes.size())
+                    throw runtime_error("The container ends before its last block");
+                c.source = c.bytes.data();
+            }
 
-    return p;
+            c.size = min<uint64_t>(c.count * chars, header.length - next * chars);
+            if(outMap.isOpen())
+            {
+                c.dest = outMap.data() + next * chars;
+            }
+            else
+            {
+                c.out.resize(c.size);
+                c.dest = (unsigned char*)&c.out[0];
+            }
+
+            next += c.count;
+            return true;
+        },
+        [&](rsa_chunk& c)
+        {
+            for(size_t b=0; b<c.count; b++)
+            {
+                packBlock(c.source + b * width, width, c.block);
+                if(c.block >= privatek.n)
+                    throw runtime_error("The container has a block which is not less than n");
+
+                decryptBlock(c.block, privatek, c.scratch);
+                if((b + 1) * chars <= c.size)
+                {
+                    unpackBlock(c.block, c.dest + b * chars, chars);
+                }
+                else
+                {
+                    //Only one chunk holds the last block
+                    unpackBlock(c.block, last.data(), chars);
+                    copy(last.begin(), last.begin() + (c.size - b * chars), c.dest + b * chars);
+                }
+            }
+        },
+        [&](rsa_chunk& c)
+        {
+            //Mapped output was written in place by the worker
+            if(!outMap.isOpen())
+                outStream->write(c.out.data(), c.out.size());
+        });
 }
 
-void encrypt(istream& in, ostream& out, const rsa_key& publick)
+void encryptSession(const mapped_file& inMap, istream* inStream, const mapped_file& outMap, ostream* outStream,
+                    const rsa_key& publick, unsigned threads)
 {
-    uint64_t chars = blockSize(publick.n);
-    while(in)
-    {
-        //Buffer
-        unsigned char c = 0;
+    size_t width = modulusBytes(publick.n);
+    session_key session = randomSession();
 
-        //Block
-        mpz_class block = 0;
+    vector<unsigned char> front(HEADER_SIZE + width);
+    storeHeader(makeHeader(publick, 1, 0, container_kind::Session), front.data());
+    wrapSession(session, publick, front.data() + HEADER_SIZE);
 
-        //Read a block or until end of file; whichever is first
-        for(uint64_t i=0; i < chars && (c = in.get()); block = block + c*cryptomath::powInt<mpz_class>(256, chars-(i++)-1));
+    if(outMap.isOpen())
+        copy(front.begin(), front.end(), outMap.data());
+    else
+        outStream->write((char*)front.data(), front.size());
 
-        //Encrypt and write
-        out << hex << cryptomath::powMod<mpz_class>(block, publick.de, publick.n) << " ";
-    }
+    streamSession(inMap, 0, inStream, outMap, front.size(), outStream, session, threads);
 }
 
-void decrypt(istream& in, ostream& out, const rsa_key& privatek)
+session_key loadSession(const mapped_file& inMap, istream* inStream, const container_header& header, const rsa_key& privatek)
 {
-    uint64_t chars = blockSize(privatek.n);  
-    
-    while(in)
-    {
-        //Buffer
-        mpz_class block;
+    if(header.blocks != 1)
+        throw runtime_error("A session container must have exactly one wrapped session key");
 
-        //Read block
-        in >> hex >> block;
+    vector<unsigned char> wrapped(header.width);
+    if(inMap.isOpen())
+    {
+        if(inMap.size() < HEADER_SIZE + header.width)
+            throw runtime_error("The container ends before its wrapped session key");
+        copy(inMap.data() + HEADER_SIZE, inMap.data() + HEADER_SIZE + header.width, wrapped.begin());
+    }
+    else
+    {
+        inStream->read((char*)wrapped.data(), wrapped.size());
+        if((size_t)inStream->gcount() != wrapped.size())
+            throw runtime_error("The container ends before its wrapped session key");
+    }
 
-        //Decrypt
-        block = cryptomath::powMod<mpz_class>(block, privatek.de, privatek.n);
+    rsa_scratch scratch;
+    return unwrapSession(wrapped.data(), privatek, scratch);
+}
 
-        //Divider
-        mpz_class power = cryptomath::powInt<mpz_class>(256, chars-1);
+void streamSession(const mapped_file& inMap, size_t inStart, istream* inStream, const mapped_file& outMap, size_t outStart,
+                   ostream* outStream, const session_key& session, unsigned threads)
+{
+    des64_engine::key_schedule schedule(session.keys[0], session.keys[1], session.keys[2]);
 
-        //Decompose into characters and write
-        for(uint64_t i=0; i < chars; i++)
+    uint64_t done = 0;
+    parallel::ordered<session_chunk>(threads,
+        [&](session_chunk& c)
         {
-            unsigned char c = mpz_class(block / power).get_ui();
-            block = block - c*power;
-            power = power / 256;
-            out << c;
-        }
-    }
+            if(inMap.isOpen())
+            {
+                c.size = min<uint64_t>(SESSION_CHUNK_BLOCKS * 8, inMap.size() - inStart - done);
+                c.source = inMap.data() + inStart + done;
+            }
+            else
+            {
+                inStream->read((char*)c.bytes.data(), c.bytes.size());
+                c.size = inStream->gcount();
+                c.source = c.bytes.data();
+            }
+            if(!c.size) return false;
+
+            c.dest = (outMap.isOpen() ? outMap.data() + outStart + done : c.bytes.data());
+            c.counter = session.iv + done / 8;
+            done += c.size;
+            return true;
+        },
+        [&](session_chunk& c)
+        {
+            applyKeyStream(schedule, c.counter, c.source, c.dest, c.size, c.blocks.data(), c.scratch.data());
+        },
+        [&](session_chunk& c)
+        {
+            //Mapped output was written in place by the worker
+            if(!outMap.isOpen())
+                outStream->write((char*)c.dest, c.size);
+        });
 }
 
-bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2, string& file3, uint64_t& bits)
+bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2, string& file3, uint64_t& bits, Format& format, unsigned& threads)
 {
     file1 = file2 = file3 = "";
     bits = 0;
+    format = Format::Binary;
+    threads = 1;
 
     op = Mode::None;
 
@@ -506,6 +984,34 @@ bool processArgs(int argc, char** argv, Mode& op, string& file1, string& file2,
             file2 = argv[++i];
             file3 = argv[++i];
         }
+        else if(arg == "-f")
+        {
+            string value = (i < argc-1 ? argv[++i] : "");
+            if(value == "binary")
+                format = Format::Binary;
+            else if(value == "hex")
+                format = Format::Hex;
+            else if(value == "hybrid")
+                format = Format::Hybrid;
+            else
+            {
+                help(argv[0], "Choose the format with -f [binary, hex, hybrid]");
+                return false;
+            }
+        }
+        else if(arg == "-j")
+        {
+            try{
+                if(i >= argc-1) throw logic_error("");
+                threads = stoul(argv[++i]);
+            }catch(exception& ex){
+                help(argv[0], "Specify number of threads with -j [threads]");
+                return false;
+            }
+
+            if(threads == 0)
+                threads = parallel::hardwareThreads();
+        }
         else if(arg == "-h")
         {
             help(argv[0], "");
@@ -533,7 +1039,7 @@ void help(string name, string msg)
 
     cout << "Usage: \n\
 tool_rsa -g public private bits\n\
-tool_rsa -e/-d input output key\n\
+tool_rsa -e/-d input output key [-f format] [-j n]\n\
 \n\
 Mode Options\n\
     -g : To generate a public, private key pair. \n\
@@ -550,6 +1056,15 @@ Output Options\n\
 Key Options\n\
     The key should be the file name of the key to use.\n\
     \n\
+Format Options\n\
+    -f binary : Encrypt to a binary container. Default\n\
+    -f hex : Encrypt to hexadecimal text, with each block separated by a space\n\
+    -f hybrid : Encrypt a random session key with RSA, and the input with the session key\n\
+    Decryption recognizes every format, so -f only affects encryption.\n\
+    \n\
+Other Options\n\
+    -j n : Encrypt or decrypt on n threads; 0 uses one thread per core. Defaults to 1\n\
+    \n\
 Keys should generally be larger than 2048 bits for security; 3072 bits if they will be used through the year 2030.\n\
 Picking a number of bits less than 8 will fail because n must be at least 256\n\
 The key file for encryption should be a public key, and for decryption should the matching private key." << endl;